@@ -0,0 +1,157 @@
+#include "BitPlaneGrid.h"
+#include <iostream>
+#include <algorithm>
+
+/**
+ * @brief BitPlaneGrid 构造函数。
+ */
+BitPlaneGrid::BitPlaneGrid(int width, int height, std::shared_ptr<const Ruleset> ruleset)
+    : width(width), height(height) {
+    wordsPerRow = wordsForBits(width);
+    moduleCount = ruleset->getModuleCount();
+
+    rowMask.assign(wordsPerRow, ~uint64_t(0));
+    if (width % 64 != 0) {
+        rowMask[wordsPerRow - 1] = (uint64_t(1) << (width % 64)) - 1;
+    }
+
+    planes.resize(moduleCount);
+    for (int m = 0; m < moduleCount; ++m) {
+        planes[m].resize(static_cast<size_t>(height) * wordsPerRow);
+    }
+    dirtyRows.resize(height);
+    nextDirtyRows.resize(height);
+    reset();
+
+    supporters.resize(static_cast<size_t>(moduleCount) * COUNT);
+    for (int m = 0; m < moduleCount; ++m) {
+        for (int dir = 0; dir < COUNT; ++dir) {
+            std::vector<int>& list = supporters[m * COUNT + dir];
+            ruleset->forEachCompatible(m, dir, [&list](int k) { list.push_back(k); });
+        }
+    }
+}
+
+/**
+ * @brief 把网格恢复为所有单元格包含全部模块。
+ */
+void BitPlaneGrid::reset() {
+    for (int m = 0; m < moduleCount; ++m) {
+        for (int y = 0; y < height; ++y) {
+            std::copy(rowMask.begin(), rowMask.end(), planes[m].begin() + static_cast<size_t>(y) * wordsPerRow);
+        }
+    }
+}
+
+/**
+ * @brief 在所有单元格中禁用一个模块。
+ */
+void BitPlaneGrid::banModule(int module) {
+    std::fill(planes[module].begin(), planes[module].end(), 0);
+}
+
+/**
+ * @brief 在掩码选中的单元格中禁用一个模块。
+ */
+void BitPlaneGrid::banModule(int module, const uint64_t* cellMask) {
+    std::vector<uint64_t>& plane = planes[module];
+    for (size_t i = 0; i < plane.size(); ++i) {
+        plane[i] &= ~cellMask[i];
+    }
+}
+
+/**
+ * @brief 用四个方向的邻居支持约束一个模块的一行。
+ * 邻居平面经过移位与当前行对齐后按位或得到支持掩码，网格边界外视为总是有支持。
+ * @return 如果这一行有模块被删除则返回 true。
+ */
+bool BitPlaneGrid::reviseRow(int module, int y) {
+    uint64_t* row = &planes[module][static_cast<size_t>(y) * wordsPerRow];
+    bool changed = false;
+
+    for (int w = 0; w < wordsPerRow; ++w) {
+        uint64_t current = row[w];
+        if (!current) continue;
+
+        // TOP / BOTTOM：上下两行同一个字
+        uint64_t topSupport = (y == 0) ? ~uint64_t(0) : 0;
+        uint64_t bottomSupport = (y == height - 1) ? ~uint64_t(0) : 0;
+        // LEFT：单元格 x 读取 x - 1 的位，整体左移一位；RIGHT 同理右移
+        uint64_t leftSupport = (w == 0) ? uint64_t(1) : 0;
+        uint64_t rightSupport = (w == wordsPerRow - 1) ? uint64_t(1) << ((width - 1) % 64) : 0;
+
+        for (int k : supporters[module * COUNT + TOP]) {
+            if (y > 0) topSupport |= planes[k][static_cast<size_t>(y - 1) * wordsPerRow + w];
+        }
+        for (int k : supporters[module * COUNT + BOTTOM]) {
+            if (y < height - 1) bottomSupport |= planes[k][static_cast<size_t>(y + 1) * wordsPerRow + w];
+        }
+        for (int k : supporters[module * COUNT + LEFT]) {
+            const uint64_t* neighborRow = &planes[k][static_cast<size_t>(y) * wordsPerRow];
+            leftSupport |= (neighborRow[w] << 1) | (w > 0 ? neighborRow[w - 1] >> 63 : 0);
+        }
+        for (int k : supporters[module * COUNT + RIGHT]) {
+            const uint64_t* neighborRow = &planes[k][static_cast<size_t>(y) * wordsPerRow];
+            rightSupport |= (neighborRow[w] >> 1) | (w + 1 < wordsPerRow ? neighborRow[w + 1] << 63 : 0);
+        }
+
+        uint64_t revised = current & topSupport & bottomSupport & leftSupport & rightSupport;
+        if (revised != current) {
+            row[w] = revised;
+            changed = true;
+        }
+    }
+    return changed;
+}
+
+/**
+ * @brief 把整个网格处理到弧相容。
+ * 按行交替正向、反向扫描；只有本行或相邻行在上一轮发生变化的行才需要重新检查。
+ */
+bool BitPlaneGrid::enforceArcConsistency() {
+    std::vector<char>& dirty = dirtyRows;
+    std::vector<char>& nextDirty = nextDirtyRows;
+    std::fill(dirty.begin(), dirty.end(), 1);
+    bool anyDirty = true;
+    bool forward = true;
+    int sweeps = 0;
+
+    while (anyDirty) {
+        anyDirty = false;
+        std::fill(nextDirty.begin(), nextDirty.end(), 0);
+        for (int i = 0; i < height; ++i) {
+            int y = forward ? i : height - 1 - i;
+            if (!dirty[y]) continue;
+
+            bool rowChanged = false;
+            for (int m = 0; m < moduleCount; ++m) {
+                rowChanged |= reviseRow(m, y);
+            }
+            if (rowChanged) {
+                // 本轮中后续扫描到的相邻行会直接看到变化，仍标记下一轮以处理已经扫过的行
+                nextDirty[y] = 1;
+                if (y > 0) nextDirty[y - 1] = 1;
+                if (y < height - 1) nextDirty[y + 1] = 1;
+                anyDirty = true;
+            }
+        }
+        dirty.swap(nextDirty);
+        forward = !forward;
+        sweeps++;
+    }
+
+    // 检查是否有单元格失去了所有可能模块
+    for (int y = 0; y < height; ++y) {
+        for (int w = 0; w < wordsPerRow; ++w) {
+            uint64_t any = 0;
+            for (int m = 0; m < moduleCount; ++m) {
+                any |= planes[m][static_cast<size_t>(y) * wordsPerRow + w];
+            }
+            if (any != rowMask[w]) {
+                std::cout << "Arc consistency pass found an empty cell in row " << y << " after " << sweeps << " sweeps." << std::endl;
+                return false;
+            }
+        }
+    }
+    return true;
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <vector>
+#include <memory>
+#include <cstdint>
+#include "Ruleset.h"
+#include "BitUtils.h"
+
+/**
+ * @class BitPlaneGrid
+ * @brief 按模块切片的网格可能性表示。
+ * 每个模块一张位平面：第 y 行第 w 个字的第 i 位表示单元格 (64 * w + i, y) 中该模块仍然可能，
+ * 每行补齐到 64 位。全网格的约束检查因此变成对 64 个单元格同时进行的移位与按位与/或，
+ * 适合在搜索开始前对超大地图做一次整体弧相容处理和批量禁用。
+ */
+class BitPlaneGrid {
+public:
+    /**
+     * @brief BitPlaneGrid 构造函数，初始时所有单元格包含全部模块。
+     * @param width 网格宽度。
+     * @param height 网格高度。
+     * @param ruleset 共享的只读规则集。
+     */
+    BitPlaneGrid(int width, int height, std::shared_ptr<const Ruleset> ruleset);
+
+    /**
+     * @brief 把网格恢复为所有单元格包含全部模块，便于重复使用已分配的位平面。
+     */
+    void reset();
+
+    /**
+     * @brief 在所有单元格中禁用一个模块。
+     */
+    void banModule(int module);
+
+    /**
+     * @brief 在掩码选中的单元格中禁用一个模块。
+     * @param module 模块索引。
+     * @param cellMask 与位平面布局相同的单元格掩码（height * getWordsPerRow() 个字）。
+     */
+    void banModule(int module, const uint64_t* cellMask);
+
+    /**
+     * @brief 把整个网格处理到弧相容：任一方向上得不到邻居支持的模块都会被删除，直到不再变化。
+     * @return 如果所有单元格都还有可能模块则返回 true，否则返回 false。
+     */
+    bool enforceArcConsistency();
+
+    /**
+     * @brief 检查单元格中某个模块是否仍然可能。
+     */
+    bool isPossible(int x, int y, int module) const {
+        return (planes[module][static_cast<size_t>(y) * wordsPerRow + x / 64] >> (x % 64)) & 1;
+    }
+
+    int getWordsPerRow() const { return wordsPerRow; }
+    const uint64_t* getPlane(int module) const { return planes[module].data(); }
+
+private:
+    int width, height;                                  // 网格尺寸
+    int wordsPerRow;                                    // 每行占用的 64 位字数
+    int moduleCount;                                    // 模块数量
+    std::vector<std::vector<uint64_t>> planes;          // [模块][y * wordsPerRow + w]：模块可能性位平面
+    std::vector<uint64_t> rowMask;                      // 一行中有效单元格的掩码（排除补齐位）
+    std::vector<std::vector<int>> supporters;           // [模块 * 4 + 方向]：该方向上可以与模块相邻的模块
+    std::vector<char> dirtyRows, nextDirtyRows;         // 弧相容扫描中需要重新检查的行
+
+    bool reviseRow(int module, int y);                  // 用四个方向的邻居支持约束一个模块的一行
+};
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <cstdint>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+/**
+ * @brief 位运算辅助函数。
+ * 可能模块集合在生成器内部以 64 位字组成的位集存储，这里封装了跨编译器的位计数与位扫描。
+ */
+
+// 统计一个 64 位字中被置位的比特数
+inline int popCount64(uint64_t value) {
+#ifdef _MSC_VER
+    return static_cast<int>(__popcnt64(value));
+#else
+    return __builtin_popcountll(value);
+#endif
+}
+
+// 返回最低置位比特的下标（value 不能为 0）
+inline int lowestBitIndex(uint64_t value) {
+#ifdef _MSC_VER
+    unsigned long index;
+    _BitScanForward64(&index, value);
+    return static_cast<int>(index);
+#else
+    return __builtin_ctzll(value);
+#endif
+}
+
+// 计算容纳 bitCount 个比特所需的 64 位字数
+inline int wordsForBits(int bitCount) {
+    return (bitCount + 63) / 64;
+}
@@ -4,12 +4,12 @@
 #include <iostream>   
 
 /**
- * @brief ģ鶨JSONļмģ鼰Ӿڽӹ
- * @param filepath ģļ·
- * @return سɹ true򷵻 false
+ * @brief 从模块定义JSON文件中加载所有模块及其视觉和邻接规则。
+ * @param filepath 模块文件的路径。
+ * @return 如果加载成功，返回 true；否则返回 false。
  */
 bool DataManager::loadModulesFromFile(const std::string& filepath) {
-    // Դļ
+    // 尝试打开文件
     std::ifstream file(filepath);
     if (!file.is_open()) {
         std::cerr << "ERROR: Cannot open module file: " << filepath << std::endl;
@@ -17,56 +17,62 @@ bool DataManager::loadModulesFromFile(const std::string& filepath) {
     }
 
     try {
-        // ʹ nlohmann/json ļ
+        // 使用 nlohmann/json 库解析文件内容
         json data = json::parse(file);
 
-        // ϢJSONûʹĬֵ
-        tileSize = data.value("tile_size", 32); // ȡƬߴ磬ĬΪ32
-        tilesetPath = data.value("tileset_path", "assets/tileset.png"); // ȡƬ·ĬΪ "assets/tileset.png"
+        // 加载信息，如果JSON中没有则使用默认值
+        tileSize = data.value("tile_size", 32); // 获取瓦片尺寸，默认为32
+        tilesetPath = data.value("tileset_path", "assets/tileset.png"); // 获取瓦片集路径，默认为 "assets/tileset.png"
 
-        modules.clear(); // ڼǰվɵģ
+        modules.clear(); // 在加载新数据前，清空旧的模块数据
 
-        // JSONļ "modules" ÿģ
+        // 遍历JSON文件中 "modules" 数组的每个模块对象
         for (const auto& mod_json : data["modules"]) {
-            // ȡģIDȨأʹĬֵ
+            // 获取模块ID和权重，如果不存在则使用默认值
             std::string id = mod_json.value("id", "NO_ID");
             double weight = mod_json.value("weight", 1.0);
 
-            // һµ Module ʵ
+            // 创建一个新的 Module 实例
             Module module(id, weight);
 
-            // ظģͼϵ (tile_index)
+            // 加载该模块在贴图上的坐标 (tile_index)
             if (mod_json.contains("tile_index") && mod_json["tile_index"].is_array() && mod_json["tile_index"].size() == 2) {
-                module.tileIndex.y = mod_json["tile_index"][0]; // һԪ (y)
-                module.tileIndex.x = mod_json["tile_index"][1]; // ڶԪ (x)
+                module.tileIndex.y = mod_json["tile_index"][0]; // 数组第一个元素是行 (y)
+                module.tileIndex.x = mod_json["tile_index"][1]; // 数组第二个元素是列 (x)
             }
 
-            // ڽӹ (adjacency)
+            // 加载可选的类别标签 (class)，如 road、building、nature
+            module.category = mod_json.value("class", "");
+
+            // 加载邻接规则 (adjacency)
             if (mod_json.contains("adjacency")) {
-                // ڽӹеÿһԼֵ -> ģIDб
+                // 遍历邻接规则对象中的每一对键值（方向 -> 允许的模块ID列表）
                 for (auto const& [key, val] : mod_json["adjacency"].items()) {
                     Direction dir;
-                    // JSONеַתΪö
+                    // 将JSON中的字符串方向转换为枚举类型
                     if (key == "TOP") dir = TOP;
                     else if (key == "BOTTOM") dir = BOTTOM;
                     else if (key == "LEFT") dir = LEFT;
                     else dir = RIGHT;
 
-                    // һ洢÷ģID
+                    // 创建一个集合来存储该方向上所有允许的模块ID
                     std::set<std::string> allowed_modules;
                     for (const auto& allowed_id : val) {
                         allowed_modules.insert(allowed_id.get<std::string>());
                     }
-                    // Ĺģ
+                    // 将解析出的规则存入模块
                     module.adjacencyRules[dir] = allowed_modules;
                 }
             }
-            // ȫúõģӵб
+            // 将完全配置好的模块添加到管理器列表中
             modules.push_back(module);
         }
+
+        // 把模块编译为共享的只读规则集，并合并邻接完全相同的模块以缩小求解字母表
+        ruleset = Ruleset::compressEquivalentModules(Ruleset::compile(modules));
     }
     catch (json::parse_error& e) {
-        // JSONʧܣ쳣ӡϢ
+        // 如果JSON解析失败，捕获异常并打印错误信息
         std::cerr << "JSON parse error in " << filepath << ": " << e.what() << std::endl;
         return false;
     }
@@ -74,10 +80,10 @@ bool DataManager::loadModulesFromFile(const std::string& filepath) {
 }
 
 /**
- * @brief ĿļĿá
- * ߴ硢ȫԼᴥضӦģļ
- * @param filepath Ŀļ·
- * @return سɹ true򷵻 false
+ * @brief 从项目配置文件加载整个项目的设置。
+ * 这包括网格尺寸、全局约束，并会触发加载对应的模块文件。
+ * @param filepath 项目文件的路径。
+ * @return 如果加载成功，返回 true；否则返回 false。
  */
 bool DataManager::loadProjectFromFile(const std::string& filepath) {
     std::ifstream file(filepath);
@@ -87,28 +93,28 @@ bool DataManager::loadProjectFromFile(const std::string& filepath) {
     }
     try {
         json data = json::parse(file);
-        // Ⱥ͸߶ȣʹĬֵ
+        // 加载网格宽度和高度，如果不存在则使用默认值
         gridWidth = data.value("grid_width", 10);
         gridHeight = data.value("grid_height", 10);
 
-        // Ŀжȡģļ·Ȼú
+        // 从项目配置中读取模块文件的路径，然后调用函数加载它
         std::string module_source = data.value("module_source", "wfc_modules.json");
         if (!loadModulesFromFile(module_source)) {
-            // ģļʧܣĿҲʧ
+            // 如果模块文件加载失败，则整个项目加载也失败
             return false;
         }
 
-        globalLimits.clear(); // վɵȫԼ
-        // ǷȫԼ
+        globalLimits.clear(); // 清空旧的全局约束
+        // 检查是否存在全局约束定义
         if (data.contains("global_constraints")) {
-            // Լ
+            // 遍历约束数组
             for (const auto& constraint : data["global_constraints"]) {
-                // ԼģID -> ޣmap
+                // 将约束（模块ID -> 数量上限）存入map
                 globalLimits[constraint["id"]] = constraint["limit"];
             }
         }
 
-        seed = data.value("seed", 12345); // ֵĬ12345
+        seed = data.value("seed", 12345); // 加载种子值，默认是12345
     }
     catch (json::parse_error& e) {
         std::cerr << "JSON parse error in " << filepath << ": " << e.what() << std::endl;
@@ -118,9 +124,9 @@ bool DataManager::loadProjectFromFile(const std::string& filepath) {
 }
 
 /**
- * @brief ǰĿñ浽ļ
- * @param filepath Ҫ浽Ŀļ·
- * @return ɹ true򷵻 false
+ * @brief 将当前的项目设置保存到文件。
+ * @param filepath 要保存到的项目文件的路径。
+ * @return 如果保存成功，返回 true；否则返回 false。
  */
 bool DataManager::saveProjectToFile(const std::string& filepath) {
     std::ofstream file(filepath);
@@ -130,15 +136,15 @@ bool DataManager::saveProjectToFile(const std::string& filepath) {
     }
 
     try {
-        // һյjson
+        // 创建一个空的json对象
         json data;
-        // ǰдjson
+        // 将当前设置写入json对象
         data["grid_width"] = gridWidth;
         data["grid_height"] = gridHeight;
         data["seed"] = seed;
-        data["module_source"] = "wfc_modules.json"; // ģļ
+        data["module_source"] = "wfc_modules.json"; // 假设模块文件名不变
 
-        //  globalLimits map ת json array of objects
+        // 将 globalLimits map 转换回 json array of objects
         json constraints_array = json::array();
         for (const auto& pair : globalLimits) {
             json constraint_obj;
@@ -148,11 +154,11 @@ bool DataManager::saveProjectToFile(const std::string& filepath) {
         }
         data["global_constraints"] = constraints_array;
 
-        // jsonдļ
+        // 将json对象写入文件
         file << data.dump(4);
     }
     catch (const std::exception& e) {
-		// 쳣Ϣ
+		// 异常捕获，输出错误信息
         std::cerr << "Error while saving to JSON: " << e.what() << std::endl;
         return false;
     }
@@ -1,4 +1,4 @@
-#pragma once // ָȷͷļһαֻһ
+#pragma once // 编译器指令，确保该头文件在一次编译中只被包含一次
 
 #include <string>
 #include <vector>
@@ -7,79 +7,86 @@
 #include "WFCGenerator.h"         
 #include "include/json.hpp"      
 
-// Ϊnlohmann::jsonjsonഴһ̵ıʹ
+// 为nlohmann::json库的json类创建一个更短的别名，方便后续代码使用
 using json = nlohmann::json;
 
 /**
  * @class DataManager
- * @brief WFC㷨ݺá
+ * @brief 负责管理WFC算法所需的所有数据和配置。
  *
- * ദļмĿãߴ硢ģ鶨塢Լȣ
- * ЩñļļWFC߼
+ * 这个类处理从文件中加载项目设置（如网格尺寸、模块定义、约束等），
+ * 并将这些设置保存回文件。它是连接配置文件和WFC核心逻辑的桥梁。
  */
 class DataManager {
 public:
-    // --- WFC ߼ ---
+    // --- WFC 核心逻辑所需的数据 ---
 
-	int gridWidth = 10;     //ĿȣԵԪΪλ
+	int gridWidth = 10;     //生成网格的宽度（以单元格为单位）。
 
-	int gridHeight = 10;    // ĸ߶ȣԵԪΪλ
+	int gridHeight = 10;    // 生成网格的高度（以单元格为单位）。
 
     /**
-     * @brief 洢Ѽصģ飨Module
-     * WFCGenerator ʹЩģɵͼ
+     * @brief 存储所有已加载的模块（Module）定义的向量。
+     * WFCGenerator 将使用这些模块来生成地图。
      */
     std::vector<Module> modules;
 
     /**
-     * @brief 洢ȫģƵӳ䡣
-     * ģID (std::string)ֵǸģֵ (int)
+     * @brief 由 modules 编译得到的只读规则集。
+     * 每次加载模块文件后重新编译一次，所有生成器共享同一份，无需各自复制模块。
+     * 邻接完全相同的模块会被合并为等价类，生成器在坍缩后再展开为具体模块。
+     */
+    std::shared_ptr<const Ruleset> ruleset;
+
+    /**
+     * @brief 存储全局模块数量限制的映射。
+     * 键是模块的ID (std::string)，值是该模块在整个网格中允许出现的最大数量 (int)。
      */
     std::map<std::string, int> globalLimits;
 
-    // --- ӾȾص ---
+    // --- 视觉和渲染相关的数据 ---
 
     /**
-     * @brief Ƭtileسߴ硣
-     * ڴƬtilesetȷиÿģͼ
+     * @brief 单个瓦片（tile）的像素尺寸。
+     * 用于从瓦片集（tileset）中正确地切割出每个模块的图像。
      */
     int tileSize = 32;
 
     /**
-     * @brief Ƭtilesetͼļ·
-     * һģӾʾĵͼļ
+     * @brief 瓦片集（tileset）图像文件的路径。
+     * 这是一个包含所有模块视觉表示的单个图像文件。
      */
     std::string tilesetPath = "assets/tileset.png";
 
-    // --- ļ ---
+    // --- 文件操作函数 ---
 
     /**
-     * @brief ָJSONļмģ鶨塣
-     * @param filepath ģ鶨ļ·
-     * @return سɹ true򷵻 false
+     * @brief 从指定的JSON文件中加载模块定义。
+     * @param filepath 模块定义文件的路径。
+     * @return 如果加载成功，返回 true；否则返回 false。
      */
     bool loadModulesFromFile(const std::string& filepath);
 
     /**
-     * @brief ָJSONļмĿá
-     * ߴ硢ӡԼ loadModulesFromFile ضӦģ顣
-     * @param filepath Ŀļ·
-     * @return سɹ true򷵻 false
+     * @brief 从指定的JSON文件中加载整个项目配置。
+     * 这会加载网格尺寸、种子、约束，并调用 loadModulesFromFile 来加载对应的模块。
+     * @param filepath 项目配置文件的路径。
+     * @return 如果加载成功，返回 true；否则返回 false。
      */
     bool loadProjectFromFile(const std::string& filepath);
 
     /**
-     * @brief ǰĿñ浽ָJSONļ
-     * @param filepath Ҫ浽ļ·
-     * @return ɹ true򷵻 false
+     * @brief 将当前的项目配置保存到指定的JSON文件。
+     * @param filepath 要保存到的文件的路径。
+     * @return 如果保存成功，返回 true；否则返回 false。
      */
     bool saveProjectToFile(const std::string& filepath);
 
-    // ---  ---
+    // --- 其他配置 ---
 
     /**
-     * @brief WFC㷨ӡ
-     * ʹͬӿԸͬɽ
+     * @brief 用于WFC算法的随机数生成器种子。
+     * 使用相同的种子可以复现相同的生成结果。
      */
     int seed = 12345;
 };
\ No newline at end of file
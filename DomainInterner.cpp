@@ -0,0 +1,181 @@
+#include "DomainInterner.h"
+#include "BitUtils.h"
+#include <algorithm>
+
+/**
+ * @brief DomainInterner 构造函数，预先合并完整集合作为句柄 0。
+ */
+DomainInterner::DomainInterner(const Ruleset& ruleset)
+    : ruleset(ruleset), moduleCount(ruleset.getModuleCount()), wordsPerDomain(ruleset.getWordsPerDomain()),
+    index(InitialSlots, NoHandle) {
+    pool.reserve(InitialSlots / 2 * wordsPerDomain);
+    sizes.reserve(InitialSlots / 2);
+    supportMemo.reserve(InitialSlots / 2 * COUNT);
+    scratch.assign(wordsPerDomain, ~uint64_t(0));
+    if (moduleCount % 64 != 0) {
+        scratch[wordsPerDomain - 1] = (uint64_t(1) << (moduleCount % 64)) - 1;
+    }
+    intern(scratch.data());
+}
+
+/**
+ * @brief 计算位集的哈希值（FNV-1a 风格的逐字混合）。
+ */
+uint64_t DomainInterner::hashWords(const uint64_t* words) const {
+    uint64_t hash = 1469598103934665603ULL;
+    for (int w = 0; w < wordsPerDomain; ++w) {
+        hash ^= words[w];
+        hash *= 1099511628211ULL;
+        hash ^= hash >> 29;
+    }
+    return hash;
+}
+
+/**
+ * @brief 把 64 位键打散到槽位（splitmix64 的混合步骤）。
+ */
+uint64_t DomainInterner::mixKey(uint64_t key) {
+    key ^= key >> 30;
+    key *= 0xBF58476D1CE4E5B9ULL;
+    key ^= key >> 27;
+    key *= 0x94D049BB133111EBULL;
+    return key ^ (key >> 31);
+}
+
+/**
+ * @brief 在记忆表中查找键。
+ */
+DomainInterner::Handle DomainInterner::MemoTable::find(uint64_t key) const {
+    size_t mask = keys.size() - 1;
+    for (size_t slot = mixKey(key) & mask; values[slot] != NoHandle; slot = (slot + 1) & mask) {
+        if (keys[slot] == key) return values[slot];
+    }
+    return NoHandle;
+}
+
+/**
+ * @brief 向记忆表插入一个尚不存在的键；已用槽数超过一半时先把容量加倍。
+ */
+void DomainInterner::MemoTable::insert(uint64_t key, Handle value) {
+    if ((count + 1) * 2 > keys.size()) {
+        std::vector<uint64_t> oldKeys = std::move(keys);
+        std::vector<Handle> oldValues = std::move(values);
+        keys.assign(oldKeys.size() * 2, 0);
+        values.assign(oldValues.size() * 2, NoHandle);
+        count = 0;
+        for (size_t slot = 0; slot < oldValues.size(); ++slot) {
+            if (oldValues[slot] != NoHandle) insert(oldKeys[slot], oldValues[slot]);
+        }
+    }
+    size_t mask = keys.size() - 1;
+    size_t slot = mixKey(key) & mask;
+    while (values[slot] != NoHandle) slot = (slot + 1) & mask;
+    keys[slot] = key;
+    values[slot] = value;
+    count++;
+}
+
+/**
+ * @brief 合并表容量加倍，按各集合的哈希值重新放置句柄。
+ */
+void DomainInterner::growIndex() {
+    index.assign(index.size() * 2, NoHandle);
+    size_t mask = index.size() - 1;
+    for (Handle handle = 0; handle < sizes.size(); ++handle) {
+        size_t slot = hashWords(getWords(handle)) & mask;
+        while (index[slot] != NoHandle) slot = (slot + 1) & mask;
+        index[slot] = handle;
+    }
+}
+
+/**
+ * @brief 合并一个集合，返回其句柄。
+ * 合并表按位集哈希值线性探测，遇到空槽说明集合尚不存在，新句柄就放在该槽。
+ */
+DomainInterner::Handle DomainInterner::intern(const uint64_t* words) {
+    size_t mask = index.size() - 1;
+    size_t slot = hashWords(words) & mask;
+    for (; index[slot] != NoHandle; slot = (slot + 1) & mask) {
+        if (std::equal(words, words + wordsPerDomain, getWords(index[slot]))) {
+            return index[slot];
+        }
+    }
+
+    Handle handle = static_cast<Handle>(sizes.size());
+    pool.insert(pool.end(), words, words + wordsPerDomain);
+    int size = 0;
+    for (int w = 0; w < wordsPerDomain; ++w) size += popCount64(words[w]);
+    sizes.push_back(size);
+    supportMemo.resize(supportMemo.size() + COUNT, NoHandle);
+    index[slot] = handle;
+    if (sizes.size() * 2 > index.size()) {
+        growIndex();
+    }
+    return handle;
+}
+
+/**
+ * @brief 去掉一个模块后的集合。
+ */
+DomainInterner::Handle DomainInterner::without(Handle handle, int module) {
+    Handle cached = withoutMemo.find(pairKey(handle, module));
+    if (cached != NoHandle) return cached;
+
+    std::copy(getWords(handle), getWords(handle) + wordsPerDomain, scratch.begin());
+    scratch[module / 64] &= ~(uint64_t(1) << (module % 64));
+    Handle result = intern(scratch.data());
+    withoutMemo.insert(pairKey(handle, module), result);
+    return result;
+}
+
+/**
+ * @brief 加入一个模块后的集合。
+ */
+DomainInterner::Handle DomainInterner::with(Handle handle, int module) {
+    Handle cached = withMemo.find(pairKey(handle, module));
+    if (cached != NoHandle) return cached;
+
+    std::copy(getWords(handle), getWords(handle) + wordsPerDomain, scratch.begin());
+    scratch[module / 64] |= uint64_t(1) << (module % 64);
+    Handle result = intern(scratch.data());
+    withMemo.insert(pairKey(handle, module), result);
+    return result;
+}
+
+/**
+ * @brief 两个集合的交集。
+ */
+DomainInterner::Handle DomainInterner::intersect(Handle a, Handle b) {
+    if (a == b || b == FullDomain) return a;
+    if (a == FullDomain) return b;
+    if (a > b) std::swap(a, b);
+    Handle cached = intersectMemo.find(pairKey(a, b));
+    if (cached != NoHandle) return cached;
+
+    const uint64_t* wordsA = getWords(a);
+    const uint64_t* wordsB = getWords(b);
+    for (int w = 0; w < wordsPerDomain; ++w) scratch[w] = wordsA[w] & wordsB[w];
+    Handle result = intern(scratch.data());
+    intersectMemo.insert(pairKey(a, b), result);
+    return result;
+}
+
+/**
+ * @brief 集合中所有模块在某方向上允许的邻居模块并集。
+ */
+DomainInterner::Handle DomainInterner::supportUnion(Handle handle, int dir) {
+    Handle cached = supportMemo[static_cast<size_t>(handle) * COUNT + dir];
+    if (cached != NoHandle) return cached;
+
+    std::fill(scratch.begin(), scratch.end(), 0);
+    const uint64_t* words = getWords(handle);
+    for (int w = 0; w < wordsPerDomain; ++w) {
+        for (uint64_t bits = words[w]; bits; bits &= bits - 1) {
+            ruleset.orCompatibility(w * 64 + lowestBitIndex(bits), dir, scratch.data());
+        }
+    }
+    Handle result = intern(scratch.data());
+    // intern() 可能扩展了记忆表，重新取下标
+    supportMemo[static_cast<size_t>(handle) * COUNT + dir] = result;
+    return result;
+}
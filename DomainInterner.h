@@ -0,0 +1,77 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include "Ruleset.h"
+
+/**
+ * @class DomainInterner
+ * @brief 可能模块集合的哈希合并存储。
+ * 大地图上绝大多数未坍缩单元格只有少数几种不同的可能模块集合（完整集合、去掉某个模块后的集合……），
+ * 相同的集合只保存一份，每个单元格只保存一个 32 位句柄。
+ * 在句柄上的移除/恢复模块、取交集以及按方向的支持并集都会被记忆，重复出现的传播工作变成查表。
+ * 合并表和记忆表都是开放寻址的扁平数组，只在容量加倍时申请内存；出现新集合或新组合时仍会增长，
+ * 因此启用合并存储时坍缩/传播循环不能保证零分配。不是线程安全的。
+ */
+class DomainInterner {
+public:
+    using Handle = uint32_t;
+    static constexpr Handle FullDomain = 0;             // 句柄 0 固定表示完整集合
+
+    /**
+     * @brief DomainInterner 构造函数。
+     * @param ruleset 规则集，用于计算支持并集。
+     */
+    explicit DomainInterner(const Ruleset& ruleset);
+
+    /**
+     * @brief 合并一个集合，返回其句柄；已存在时返回已有的句柄。
+     * @param words wordsPerDomain 个字的位集。
+     */
+    Handle intern(const uint64_t* words);
+
+    const uint64_t* getWords(Handle handle) const { return &pool[static_cast<size_t>(handle) * wordsPerDomain]; }
+    int getSize(Handle handle) const { return sizes[handle]; }
+
+    Handle without(Handle handle, int module);          // 去掉一个模块后的集合
+    Handle with(Handle handle, int module);             // 加入一个模块后的集合
+    Handle intersect(Handle a, Handle b);               // 两个集合的交集
+    Handle supportUnion(Handle handle, int dir);        // 集合中所有模块在某方向上允许的邻居模块并集
+
+    size_t getDomainCount() const { return sizes.size(); }  // 已合并的不同集合数量
+
+private:
+    static constexpr Handle NoHandle = 0xFFFFFFFF;      // 记忆表中尚未计算的标记
+    static constexpr size_t InitialSlots = 1024;        // 各表的初始槽数（2 的幂）
+
+    /**
+     * @struct MemoTable
+     * @brief 64 位键到句柄的开放寻址表：线性探测，已用槽数超过一半时容量加倍。
+     */
+    struct MemoTable {
+        std::vector<uint64_t> keys;                     // [槽]：键
+        std::vector<Handle> values;                     // [槽]：句柄，NoHandle 表示空槽
+        size_t count = 0;                               // 已用槽数
+
+        MemoTable() : keys(InitialSlots, 0), values(InitialSlots, NoHandle) {}
+        Handle find(uint64_t key) const;                // 查找键，不存在时返回 NoHandle
+        void insert(uint64_t key, Handle value);        // 插入一个尚不存在的键
+    };
+
+    const Ruleset& ruleset;                             // 规则集
+    int moduleCount;                                    // 模块数量
+    int wordsPerDomain;                                 // 每个位集的字数
+    std::vector<uint64_t> pool;                         // [句柄 * wordsPerDomain + w]：所有集合的位集
+    std::vector<int> sizes;                             // [句柄]：集合中的模块数量
+    std::vector<Handle> index;                          // [槽]：按位集哈希值开放寻址的句柄，NoHandle 表示空槽
+    MemoTable withoutMemo;                              // (句柄, 模块) -> 去掉模块后的句柄
+    MemoTable withMemo;                                 // (句柄, 模块) -> 加入模块后的句柄
+    MemoTable intersectMemo;                            // (句柄, 句柄) -> 交集句柄
+    std::vector<Handle> supportMemo;                    // [句柄 * 4 + 方向]：支持并集句柄，未计算时为 NoHandle
+    std::vector<uint64_t> scratch;                      // 计算新集合时使用的临时位集
+
+    uint64_t hashWords(const uint64_t* words) const;    // 计算位集的哈希值
+    void growIndex();                                   // 合并表容量加倍并重新放置所有句柄
+    static uint64_t mixKey(uint64_t key);               // 把记忆表的键打散到槽位
+    static uint64_t pairKey(Handle a, uint64_t b) { return (static_cast<uint64_t>(a) << 32) | b; }
+};
@@ -0,0 +1,101 @@
+#include "GridLayout.h"
+#include "Ruleset.h"
+#include <iostream>
+
+/**
+ * @brief GridLayout 构造函数。
+ * 预先计算块内局部索引、块内各位置的邻居偏移以及分块之间的邻接关系。
+ */
+GridLayout::GridLayout(int width, int height, CellLayout layout, int tileSize)
+    : width(width), height(height), layout(layout) {
+    if (layout == CellLayout::RowMajor) {
+        return;
+    }
+    bool powerOfTwo = tileSize > 1 && (tileSize & (tileSize - 1)) == 0;
+    if (!powerOfTwo || width % tileSize != 0 || height % tileSize != 0) {
+        std::cout << "Tiled cell layout requires grid dimensions divisible by the tile size " << tileSize
+                  << ". Falling back to row-major layout." << std::endl;
+        this->layout = CellLayout::RowMajor;
+        return;
+    }
+
+    while ((1 << tileShift) < tileSize) tileShift++;
+    tileMask = tileSize - 1;
+    localMask = tileSize * tileSize - 1;
+    tilesX = width / tileSize;
+    int tilesY = height / tileSize;
+
+    // 块内排列：分块模式按行，Morton 模式把块内 x、y 的比特交错
+    localIndex.resize(tileSize * tileSize);
+    localX.resize(tileSize * tileSize);
+    localY.resize(tileSize * tileSize);
+    for (int ly = 0; ly < tileSize; ++ly) {
+        for (int lx = 0; lx < tileSize; ++lx) {
+            int local = ly * tileSize + lx;
+            if (layout == CellLayout::Morton) {
+                local = 0;
+                for (int b = 0; b < tileShift; ++b) {
+                    local |= ((lx >> b) & 1) << (2 * b);
+                    local |= ((ly >> b) & 1) << (2 * b + 1);
+                }
+            }
+            localIndex[ly * tileSize + lx] = local;
+            localX[local] = lx;
+            localY[local] = ly;
+        }
+    }
+
+    const int dx[] = { 0, 0, -1, 1 }; // TOP, BOTTOM, LEFT, RIGHT
+    const int dy[] = { -1, 1, 0, 0 };
+    localSteps.resize(static_cast<size_t>(tileSize) * tileSize * COUNT);
+    for (int local = 0; local < tileSize * tileSize; ++local) {
+        for (int dir = 0; dir < COUNT; ++dir) {
+            int nx = localX[local] + dx[dir];
+            int ny = localY[local] + dy[dir];
+            LocalStep& step = localSteps[local * COUNT + dir];
+            step.crossesTile = nx < 0 || nx >= tileSize || ny < 0 || ny >= tileSize;
+            int target = localIndex[(ny & tileMask) * tileSize + (nx & tileMask)];
+            step.offset = step.crossesTile ? target : target - local;
+        }
+    }
+
+    tileNeighbors.resize(static_cast<size_t>(tilesX) * tilesY * COUNT);
+    for (int ty = 0; ty < tilesY; ++ty) {
+        for (int tx = 0; tx < tilesX; ++tx) {
+            for (int dir = 0; dir < COUNT; ++dir) {
+                int nx = tx + dx[dir];
+                int ny = ty + dy[dir];
+                bool outside = nx < 0 || nx >= tilesX || ny < 0 || ny >= tilesY;
+                tileNeighbors[(ty * tilesX + tx) * COUNT + dir] = outside ? -1 : ny * tilesX + nx;
+            }
+        }
+    }
+}
+
+/**
+ * @brief 由存储索引计算坐标。
+ */
+void GridLayout::coordinatesOf(int index, int& x, int& y) const {
+    if (layout == CellLayout::RowMajor) {
+        x = index % width;
+        y = index / width;
+        return;
+    }
+    int tile = index >> (2 * tileShift);
+    int local = index & localMask;
+    x = ((tile % tilesX) << tileShift) + localX[local];
+    y = ((tile / tilesX) << tileShift) + localY[local];
+}
+
+/**
+ * @brief 按行排列时的邻居查找。
+ */
+int GridLayout::rowMajorNeighbor(int index, int dir) const {
+    switch (dir) {
+    case TOP:    return index >= width ? index - width : -1;
+    case BOTTOM: return index + width < width * height ? index + width : -1;
+    case LEFT:   return index % width != 0 ? index - 1 : -1;
+    case RIGHT:  return index % width != width - 1 ? index + 1 : -1;
+    default:     return -1;
+    }
+}
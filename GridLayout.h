@@ -0,0 +1,88 @@
+#pragma once
+
+#include <vector>
+
+/**
+ * @enum CellLayout
+ * @brief 单元格在扁平存储中的排列方式。
+ */
+enum class CellLayout {
+    RowMajor,   // 按行排列：纵向邻居相隔整整一行
+    Tiled,      // 按分块排列：分块按行排列，分块内部也按行排列
+    Morton      // 按分块排列，分块内部使用 Z 序（Morton 序）
+};
+
+/**
+ * @class GridLayout
+ * @brief 网格坐标与扁平存储索引之间的映射。
+ * 分块模式下，超大网格中相邻的单元格绝大多数落在同一个分块内，纵向访问不再跨越整行，
+ * 提升传播时的缓存命中率。邻居查找使用按块内位置预先计算的偏移表，只有跨越分块边界时
+ * 才查询分块邻接表。网格宽高不是分块边长的整数倍时退回到按行排列。
+ */
+class GridLayout {
+public:
+    /**
+     * @brief GridLayout 构造函数。
+     * @param width 网格宽度。
+     * @param height 网格高度。
+     * @param layout 期望的排列方式。
+     * @param tileSize 分块边长，必须是 2 的幂。
+     */
+    GridLayout(int width = 0, int height = 0, CellLayout layout = CellLayout::RowMajor, int tileSize = 8);
+
+    /**
+     * @brief 由坐标计算存储索引。
+     */
+    int indexOf(int x, int y) const {
+        if (layout == CellLayout::RowMajor) {
+            return y * width + x;
+        }
+        int tile = (y >> tileShift) * tilesX + (x >> tileShift);
+        int local = localIndex[((y & tileMask) << tileShift) | (x & tileMask)];
+        return (tile << (2 * tileShift)) | local;
+    }
+
+    /**
+     * @brief 查找某个方向上的邻居。
+     * @param index 单元格的存储索引。
+     * @param dir 方向（TOP, BOTTOM, LEFT, RIGHT）。
+     * @return 邻居的存储索引，超出网格时返回 -1。
+     */
+    int neighbor(int index, int dir) const {
+        if (layout == CellLayout::RowMajor) {
+            return rowMajorNeighbor(index, dir);
+        }
+        const LocalStep& step = localSteps[((index & localMask) << 2) | dir];
+        if (!step.crossesTile) {
+            return index + step.offset;
+        }
+        int tile = tileNeighbors[((index >> (2 * tileShift)) << 2) | dir];
+        return tile < 0 ? -1 : (tile << (2 * tileShift)) | step.offset;
+    }
+
+    /**
+     * @brief 由存储索引计算坐标。
+     */
+    void coordinatesOf(int index, int& x, int& y) const;
+
+    CellLayout getLayout() const { return layout; }
+
+private:
+    struct LocalStep {
+        int offset;         // 不跨块时为索引增量；跨块时为目标分块内的局部索引
+        bool crossesTile;   // 是否跨越分块边界
+    };
+
+    int width, height;                  // 网格尺寸
+    CellLayout layout;                  // 实际使用的排列方式
+    int tileShift = 0;                  // 分块边长的以 2 为底的对数
+    int tileMask = 0;                   // 分块内坐标掩码
+    int localMask = 0;                  // 块内局部索引掩码
+    int tilesX = 0;                     // 横向分块数量
+    std::vector<int> localIndex;        // [块内 y * 边长 + 块内 x]：块内局部索引
+    std::vector<int> localX, localY;    // [块内局部索引]：块内坐标
+    std::vector<LocalStep> localSteps;  // [块内局部索引 * 4 + 方向]：邻居偏移
+    std::vector<int> tileNeighbors;     // [分块 * 4 + 方向]：相邻分块，越界为 -1
+
+    int rowMajorNeighbor(int index, int dir) const; // 按行排列时的邻居查找
+};
@@ -0,0 +1,27 @@
+#include "PackedResultGrid.h"
+#include <algorithm>
+
+/**
+ * @brief 按单元格数量和模块数量重新配置网格。
+ */
+bool PackedResultGrid::configure(size_t cellCount, int valueCount) {
+    bool needWide = valueCount > narrowEmpty; // 索引 0..254 都小于单字节的未坍缩标记
+    if (needWide != wide) {
+        // 切换存储宽度时释放另一种存储
+        std::vector<uint8_t>().swap(narrowValues);
+        std::vector<uint16_t>().swap(wideValues);
+        wide = needWide;
+    }
+    if (wide) wideValues.resize(cellCount);
+    else narrowValues.resize(cellCount);
+    clearAll();
+    return valueCount <= MaxValueCount;
+}
+
+/**
+ * @brief 把所有单元格标记为未坍缩。
+ */
+void PackedResultGrid::clearAll() {
+    if (wide) std::fill(wideValues.begin(), wideValues.end(), wideEmpty);
+    else std::fill(narrowValues.begin(), narrowValues.end(), narrowEmpty);
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * @class PackedResultGrid
+ * @brief 紧凑的坍缩结果网格。
+ * 每个单元格只保存选中模块的索引，模块数不超过 255 时每格 1 字节，否则每格 2 字节；
+ * 最大值保留为“未坍缩”标记，因此最多表示 MaxValueCount 个模块。16k x 16k 的结果在单字节模式下约占 256MB；
+ * 求解时的轨迹、决策栈和熵分段等运行状态仍约为每格 250 字节，这样的尺寸只有结果能放进内存。
+ * 单元格按生成器的存储索引排列，不同单元格占用不同的字节，可以被多个线程分别写入。
+ */
+class PackedResultGrid {
+public:
+    static constexpr int MaxValueCount = 0xFFFF;        // 双字节模式能表示的模块索引数量（0xFFFF 保留为未坍缩）
+
+    /**
+     * @brief 按单元格数量和模块数量重新配置网格，并把所有单元格标记为未坍缩。
+     * 尺寸不变时复用已有的存储。
+     * @param cellCount 单元格数量。
+     * @param valueCount 需要表示的模块索引数量。
+     * @return valueCount 超过 MaxValueCount 时返回 false，此时网格仍按双字节配置但不能写入。
+     */
+    bool configure(size_t cellCount, int valueCount);
+
+    /**
+     * @brief 把所有单元格标记为未坍缩。
+     */
+    void clearAll();
+
+    bool isSet(size_t index) const {
+        return wide ? wideValues[index] != wideEmpty : narrowValues[index] != narrowEmpty;
+    }
+
+    /**
+     * @brief 读取单元格的模块索引。
+     * @return 模块索引，未坍缩时返回 -1。
+     */
+    int get(size_t index) const {
+        if (wide) {
+            return wideValues[index] == wideEmpty ? -1 : wideValues[index];
+        }
+        return narrowValues[index] == narrowEmpty ? -1 : narrowValues[index];
+    }
+
+    void set(size_t index, int module) {
+        if (wide) wideValues[index] = static_cast<uint16_t>(module);
+        else narrowValues[index] = static_cast<uint8_t>(module);
+    }
+
+    void clear(size_t index) {
+        if (wide) wideValues[index] = wideEmpty;
+        else narrowValues[index] = narrowEmpty;
+    }
+
+    size_t getCellCount() const { return wide ? wideValues.size() : narrowValues.size(); }
+    int getBytesPerCell() const { return wide ? 2 : 1; }
+
+private:
+    static constexpr uint8_t narrowEmpty = 0xFF;           // 单字节模式下的未坍缩标记
+    static constexpr uint16_t wideEmpty = 0xFFFF;          // 双字节模式下的未坍缩标记
+
+    bool wide = false;                                  // 是否使用双字节存储
+    std::vector<uint8_t> narrowValues;                  // 单字节模式的存储
+    std::vector<uint16_t> wideValues;                   // 双字节模式的存储
+};
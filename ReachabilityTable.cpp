@@ -0,0 +1,162 @@
+#include "ReachabilityTable.h"
+#include "BitUtils.h"
+#include <algorithm>
+#include <cstdlib>
+
+/**
+ * @brief 计算规则集在给定半径内的可达掩码。
+ * 原点与偏移围成的矩形只有一行（或一列）时沿直线逐步展开；只有两行（或两列）时逐列求解带状区域，
+ * 两者都是区域内精确的可达集合。更宽的区域对每个最后一步的方向 dir（o - dir 的距离少 1），
+ * 把 o - dir 处的掩码沿 dir 展开后取交集。偏移按距离升序计算，因此需要的掩码总是已经算好。
+ * @param ruleset 规则集。
+ * @param radius 最大曼哈顿距离。
+ * @return 只读的可达掩码表。
+ */
+std::shared_ptr<const ReachabilityTable> ReachabilityTable::compute(const Ruleset& ruleset, int radius) {
+    std::shared_ptr<ReachabilityTable> table(new ReachabilityTable());
+    int moduleCount = ruleset.getModuleCount();
+    int words = ruleset.getWordsPerDomain();
+    table->radius = radius;
+    table->moduleCount = moduleCount;
+    table->wordsPerDomain = words;
+    if (radius < 2 || moduleCount == 0) {
+        return table;
+    }
+    size_t maskWords = static_cast<size_t>(moduleCount) * words;
+
+    std::vector<uint64_t> full(words, ~uint64_t(0));
+    if (moduleCount % 64 != 0) full[words - 1] = (uint64_t(1) << (moduleCount % 64)) - 1;
+
+    // 每个方向上全部模块的兼容行并集：来源掩码是完整集合时直接使用
+    std::vector<uint64_t> anySupport(static_cast<size_t>(COUNT) * words, 0);
+    for (int dir = 0; dir < COUNT; ++dir) {
+        for (int m = 0; m < moduleCount; ++m) ruleset.orCompatibility(m, dir, &anySupport[static_cast<size_t>(dir) * words]);
+    }
+
+    // 按距离升序列出 1 到 radius 的所有偏移，slots 把坐标映射到列表下标
+    const int stepX[COUNT] = { 0, 0, -1, 1 };
+    const int stepY[COUNT] = { -1, 1, 0, 0 };
+    int extent = 2 * radius + 1;
+    std::vector<int> slots(static_cast<size_t>(extent) * extent, -1);
+    std::vector<Offset> all;
+    for (int d = 1; d <= radius; ++d) {
+        for (int dy = -d; dy <= d; ++dy) {
+            int span = d - std::abs(dy);
+            for (int dx : { -span, span }) {
+                int& slot = slots[static_cast<size_t>(dy + radius) * extent + dx + radius];
+                if (slot >= 0) continue; // span 为 0 时两个偏移相同
+                slot = static_cast<int>(all.size());
+                all.push_back({ dx, dy });
+            }
+        }
+    }
+
+    // 单个位集在某方向上的兼容行并集；集合是完整集合时直接使用 anySupport
+    auto supportOf = [&](const uint64_t* set, int dir, uint64_t* out) {
+        if (std::equal(full.begin(), full.end(), set)) {
+            const uint64_t* any = anySupport.data() + static_cast<size_t>(dir) * words;
+            std::copy(any, any + words, out);
+            return;
+        }
+        std::fill(out, out + words, 0);
+        for (int w = 0; w < words; ++w) {
+            for (uint64_t bits = set[w]; bits; bits &= bits - 1) ruleset.orCompatibility(w * 64 + lowestBitIndex(bits), dir, out);
+        }
+    };
+
+    std::vector<uint64_t> work(all.size() * maskWords, 0);
+    std::vector<uint64_t> reach(words), spread(words);
+    std::vector<uint64_t> columns(2 * maskWords);
+    for (size_t i = 0; i < all.size(); ++i) {
+        const Offset& offset = all[i];
+        uint64_t* target = &work[i * maskWords];
+        int distance = std::abs(offset.dx) + std::abs(offset.dy);
+
+        // 沿较长的轴前进（forward），较短的轴为横向（cross）
+        bool horizontal = std::abs(offset.dx) >= std::abs(offset.dy);
+        int length = horizontal ? std::abs(offset.dx) : std::abs(offset.dy);
+        int cross = horizontal ? std::abs(offset.dy) : std::abs(offset.dx);
+        int forward = horizontal ? (offset.dx > 0 ? RIGHT : LEFT) : (offset.dy > 0 ? BOTTOM : TOP);
+        int side = horizontal ? (offset.dy > 0 ? BOTTOM : TOP) : (offset.dx > 0 ? RIGHT : LEFT);
+
+        if (cross == 0) {
+            // 一条直线：逐步展开即为精确的可达集合
+            for (int m = 0; m < moduleCount; ++m) {
+                uint64_t* to = target + static_cast<size_t>(m) * words;
+                std::fill(reach.begin(), reach.end(), 0);
+                reach[m / 64] = uint64_t(1) << (m % 64);
+                for (int step = 0; step < length; ++step) {
+                    supportOf(reach.data(), forward, to);
+                    std::copy(to, to + words, reach.begin());
+                }
+            }
+            continue;
+        }
+
+        if (cross == 1) {
+            // 两行的带状区域：逐列记录 "上行模块 t → 下行可能模块集合"，能发现两行之间的环路矛盾，结果是区域内精确的可达集合
+            for (int m = 0; m < moduleCount; ++m) {
+                uint64_t* current = columns.data();
+                uint64_t* next = columns.data() + maskWords;
+                std::fill(current, current + maskWords, 0);
+                ruleset.orCompatibility(m, side, current + static_cast<size_t>(m) * words);
+                for (int step = 0; step < length; ++step) {
+                    std::fill(next, next + maskWords, 0);
+                    for (int t = 0; t < moduleCount; ++t) {
+                        const uint64_t* lower = current + static_cast<size_t>(t) * words;
+                        bool empty = true;
+                        for (int w = 0; w < words && empty; ++w) empty = lower[w] == 0;
+                        if (empty) continue;
+                        supportOf(lower, forward, spread.data());
+                        ruleset.forEachCompatible(t, forward, [&](int u) {
+                            uint64_t* slot = next + static_cast<size_t>(u) * words;
+                            for (int w = 0; w < words; ++w) slot[w] |= spread[w];
+                        });
+                    }
+                    for (int u = 0; u < moduleCount; ++u) {
+                        uint64_t* slot = next + static_cast<size_t>(u) * words;
+                        std::fill(reach.begin(), reach.end(), 0);
+                        ruleset.orCompatibility(u, side, reach.data());
+                        for (int w = 0; w < words; ++w) slot[w] &= reach[w];
+                    }
+                    std::swap(current, next);
+                }
+                uint64_t* to = target + static_cast<size_t>(m) * words;
+                std::fill(to, to + words, 0);
+                for (int t = 0; t < moduleCount; ++t) {
+                    const uint64_t* lower = current + static_cast<size_t>(t) * words;
+                    for (int w = 0; w < words; ++w) to[w] |= lower[w];
+                }
+            }
+            continue;
+        }
+
+        // 更宽的区域：对每个最后一步的方向，把少一步的掩码展开后取交集（必要条件）
+        for (int m = 0; m < moduleCount; ++m) std::copy(full.begin(), full.end(), target + static_cast<size_t>(m) * words);
+        for (int dir = 0; dir < COUNT; ++dir) {
+            int px = offset.dx - stepX[dir], py = offset.dy - stepY[dir];
+            if (std::abs(px) + std::abs(py) != distance - 1) continue;
+            const uint64_t* source = &work[static_cast<size_t>(slots[static_cast<size_t>(py + radius) * extent + px + radius]) * maskWords];
+            for (int m = 0; m < moduleCount; ++m) {
+                uint64_t* to = target + static_cast<size_t>(m) * words;
+                supportOf(source + static_cast<size_t>(m) * words, dir, reach.data());
+                for (int w = 0; w < words; ++w) to[w] &= reach[w];
+            }
+        }
+    }
+
+    // 只保存距离至少为 2、并且至少对一个模块有约束的偏移
+    for (size_t i = 0; i < all.size(); ++i) {
+        const Offset& offset = all[i];
+        if (std::abs(offset.dx) + std::abs(offset.dy) < 2) continue;
+        const uint64_t* masks = &work[i * maskWords];
+        bool restrictive = false;
+        for (int m = 0; m < moduleCount && !restrictive; ++m) {
+            restrictive = !std::equal(full.begin(), full.end(), masks + static_cast<size_t>(m) * words);
+        }
+        if (!restrictive) continue;
+        table->offsets.push_back(offset);
+        table->masks.insert(table->masks.end(), masks, masks + maskWords);
+    }
+    return table;
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <vector>
+#include <memory>
+#include <cstdint>
+#include "Ruleset.h"
+
+/**
+ * @class ReachabilityTable
+ * @brief 规则集的多步可达掩码（离线分析）。
+ * 邻接规则只约束相邻的两个单元格；这里对每个曼哈顿距离为 2 到 radius 的偏移 (dx, dy)，
+ * 预先计算模块 m 放在原点时偏移处可能出现的模块集合，即原点与偏移围成的矩形区域能否被完整填充。
+ * 区域只有两行（或两列）时按列求解精确结果，能发现弧相容看不到的环路矛盾（例如 2×3 区域中的两个四边形环）；
+ * 更宽的区域退化为各单调路径的交集。这些都是必要条件，用它移除模块不会丢失解；
+ * 两端都在网格内时整个矩形也在网格内，因此掩码在网格边缘同样成立。
+ * 计算开销随模块数的三次方增长，只需在规则集确定后计算一次；创建后不可修改，可以被多个生成器共享。
+ */
+class ReachabilityTable {
+public:
+    /**
+     * @struct Offset
+     * @brief 相对原点的偏移。
+     */
+    struct Offset {
+        int dx;
+        int dy;
+    };
+
+    /**
+     * @brief 计算规则集在给定半径内的可达掩码。
+     * 所有模块的掩码都是完整集合的偏移不提供任何约束，不会被保存。
+     * @param ruleset 规则集。
+     * @param radius 最大曼哈顿距离（至少为 2 才有意义）。
+     * @return 只读的可达掩码表。
+     */
+    static std::shared_ptr<const ReachabilityTable> compute(const Ruleset& ruleset, int radius);
+
+    int getRadius() const { return radius; }
+    int getOffsetCount() const { return static_cast<int>(offsets.size()); }
+    const Offset& getOffset(int index) const { return offsets[index]; }
+
+    /**
+     * @brief 获取模块 module 放在原点时，第 index 个偏移处允许的模块掩码。
+     * @return 指向 wordsPerDomain 个字的掩码。
+     */
+    const uint64_t* getMask(int index, int module) const {
+        return &masks[(static_cast<size_t>(index) * moduleCount + module) * wordsPerDomain];
+    }
+
+    // 掩码占用的字节数
+    size_t getBytes() const { return masks.size() * sizeof(uint64_t) + offsets.size() * sizeof(Offset); }
+
+private:
+    ReachabilityTable() = default;
+
+    int radius = 0;                     // 计算时使用的最大距离
+    int moduleCount = 0;                // 模块数量
+    int wordsPerDomain = 0;             // 每个掩码占用的 64 位字数
+    std::vector<Offset> offsets;        // 保存的偏移，按距离升序
+    std::vector<uint64_t> masks;        // 可达掩码，按 [偏移][模块][字] 排列
+};
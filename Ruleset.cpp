@@ -0,0 +1,258 @@
+#include "Ruleset.h"
+#include "BitUtils.h"
+#include <iostream>
+#include <algorithm>
+
+/**
+ * @brief 将 Direction 枚举转换为字符串。
+ * @param dir 要转换的方向枚举。
+ * @return 对应方向的字符串表示。
+ */
+std::string directionToString(Direction dir) {
+    switch (dir) {
+    case TOP: return "TOP";
+    case BOTTOM: return "BOTTOM";
+    case LEFT: return "LEFT";
+    case RIGHT: return "RIGHT";
+    default: return "UNKNOWN";
+    }
+}
+
+/**
+ * @brief 从模块列表编译规则集。
+ * 第 m 个模块在方向 dir 上的兼容行中包含模块 n，表示模块 n 可以放在该方向上。
+ * 只遍历每个模块声明的邻接列表并检查对方是否也接受它，编译开销与允许的模块对数量成正比。
+ * @param modules 模块列表。
+ * @return 编译后的只读规则集。
+ */
+std::shared_ptr<const Ruleset> Ruleset::compile(const std::vector<Module>& modules) {
+    std::shared_ptr<Ruleset> ruleset(new Ruleset());
+    ruleset->modules = modules;
+
+    int moduleCount = static_cast<int>(modules.size());
+    ruleset->wordsPerDomain = wordsForBits(moduleCount);
+    ruleset->weights.reserve(moduleCount);
+    ruleset->tileIndices.reserve(moduleCount);
+    for (int m = 0; m < moduleCount; ++m) {
+        ruleset->moduleIndices[modules[m].id] = m;
+        ruleset->weights.push_back(modules[m].weight);
+        ruleset->tileIndices.push_back(modules[m].tileIndex);
+    }
+
+    // ID 可能重复，与 Module::isCompatible 一样按 ID 匹配所有同名模块
+    std::unordered_map<std::string, std::vector<int>> indicesById;
+    for (int m = 0; m < moduleCount; ++m) {
+        indicesById[modules[m].id].push_back(m);
+    }
+
+    const Direction opposite[] = { BOTTOM, TOP, RIGHT, LEFT };
+    std::vector<std::vector<int>> lists(static_cast<size_t>(moduleCount) * COUNT);
+    for (int m = 0; m < moduleCount; ++m) {
+        for (const auto& rule : modules[m].adjacencyRules) {
+            Direction dir = rule.first;
+            if (dir < 0 || dir >= COUNT) continue;
+            std::vector<int>& list = lists[static_cast<size_t>(m) * COUNT + dir];
+            for (const std::string& otherId : rule.second) {
+                auto it = indicesById.find(otherId);
+                if (it == indicesById.end()) continue;
+                for (int n : it->second) {
+                    auto back = modules[n].adjacencyRules.find(opposite[dir]);
+                    if (back != modules[n].adjacencyRules.end() && back->second.count(modules[m].id)) {
+                        list.push_back(n);
+                    }
+                }
+            }
+            std::sort(list.begin(), list.end());
+            list.erase(std::unique(list.begin(), list.end()), list.end());
+        }
+    }
+    ruleset->buildCompatibility(lists);
+    ruleset->buildCategories();
+    return ruleset;
+}
+
+/**
+ * @brief 由每行的有序索引列表建立兼容行。
+ * 索引列表（每项 4 字节）比稠密位集小时以列表存储，否则以位集存储。
+ * @param lists [模块 * 4 + 方向]：有序、无重复的模块索引列表。
+ */
+void Ruleset::buildCompatibility(const std::vector<std::vector<int>>& lists) {
+    rows.assign(lists.size(), CompatibilityRow());
+    denseWords.clear();
+    sparseIndices.clear();
+    size_t denseCount = 0;
+    for (size_t r = 0; r < lists.size(); ++r) {
+        const std::vector<int>& list = lists[r];
+        CompatibilityRow& row = rows[r];
+        row.count = static_cast<uint32_t>(list.size());
+        row.dense = list.size() * sizeof(int) >= static_cast<size_t>(wordsPerDomain) * sizeof(uint64_t);
+        if (row.dense) {
+            row.offset = static_cast<uint32_t>(denseWords.size());
+            denseWords.resize(denseWords.size() + wordsPerDomain, 0);
+            for (int n : list) denseWords[row.offset + n / 64] |= uint64_t(1) << (n % 64);
+            denseCount++;
+        }
+        else {
+            row.offset = static_cast<uint32_t>(sparseIndices.size());
+            sparseIndices.insert(sparseIndices.end(), list.begin(), list.end());
+        }
+    }
+    if (getModuleCount() > 64) {
+        std::cout << "Compiled adjacency: " << denseCount << " dense rows, " << rows.size() - denseCount
+                  << " sparse rows, " << getCompatibilityBytes() << " bytes." << std::endl;
+    }
+}
+
+/**
+ * @brief 由模块的类别标签建立类别掩码和类别兼容关系。
+ * 类别 A 在 dir 方向上允许类别 B，当且仅当 A 的某个成员在该方向上允许 B 的某个成员，
+ * 因此只需遍历一次兼容行。类别超过 64 个、或类别兼容关系不能排除任何类别对时，不启用类别级传播。
+ */
+void Ruleset::buildCategories() {
+    int moduleCount = getModuleCount();
+    std::unordered_map<std::string, int> categoryIndices;
+    categoryNames.clear();
+    categoryOf.assign(moduleCount, 0);
+    for (int m = 0; m < moduleCount; ++m) {
+        auto it = categoryIndices.emplace(modules[m].category, static_cast<int>(categoryNames.size())).first;
+        if (it->second == static_cast<int>(categoryNames.size())) categoryNames.push_back(modules[m].category);
+        categoryOf[m] = it->second;
+    }
+
+    int count = static_cast<int>(categoryNames.size());
+    categoryMasks.clear();
+    categorySupport.clear();
+    categoryCount = 0;
+    if (count < 2) return;
+    if (count > 64) {
+        std::cout << "Module classes: " << count << " classes exceed 64, class-level propagation is disabled." << std::endl;
+        return;
+    }
+
+    categoryCount = count;
+    categoryMasks.assign(static_cast<size_t>(count) * wordsPerDomain, 0);
+    categorySupport.assign(static_cast<size_t>(count) * COUNT, 0);
+    for (int m = 0; m < moduleCount; ++m) {
+        categoryMasks[static_cast<size_t>(categoryOf[m]) * wordsPerDomain + m / 64] |= uint64_t(1) << (m % 64);
+        for (int dir = 0; dir < COUNT; ++dir) {
+            uint64_t& allowed = categorySupport[categoryOf[m] * COUNT + dir];
+            forEachCompatible(m, dir, [&](int n) { allowed |= uint64_t(1) << categoryOf[n]; });
+        }
+    }
+
+    uint64_t allCategories = count == 64 ? ~uint64_t(0) : (uint64_t(1) << count) - 1;
+    bool informative = false;
+    for (uint64_t allowed : categorySupport) informative = informative || allowed != allCategories;
+    if (!informative) {
+        std::cout << "Module classes: every class pair is allowed, class-level propagation is disabled." << std::endl;
+        categoryCount = 0;
+    }
+}
+
+/**
+ * @brief 检查模块 other 是否可以放在 module 的 dir 方向上。
+ */
+bool Ruleset::isCompatibleIndex(int module, int dir, int other) const {
+    const CompatibilityRow& row = rows[static_cast<size_t>(module) * COUNT + dir];
+    if (row.count == 0) return false;
+    if (row.dense) {
+        return (denseWords[row.offset + other / 64] >> (other % 64)) & 1;
+    }
+    const int* indices = sparseIndices.data() + row.offset;
+    return std::binary_search(indices, indices + row.count, other);
+}
+
+/**
+ * @brief 根据模块ID查找模块索引。
+ * @param id 模块ID。
+ * @return 模块索引，找不到时返回 -1。
+ */
+int Ruleset::findModule(const std::string& id) const {
+    auto it = moduleIndices.find(id);
+    return it != moduleIndices.end() ? it->second : -1;
+}
+
+/**
+ * @brief 合并邻接完全相同的模块，得到压缩后的规则集。
+ * 以四个方向的兼容掩码拼接作为键对模块分组，只合并同一类别的模块；由于兼容关系是双向的，
+ * 行相同也意味着其他模块接受它们的方式相同，等价类之间的兼容掩码可以直接取任一成员。
+ * @param ruleset 原始规则集。
+ * @return 压缩后的规则集；没有可合并的模块时直接返回原规则集。
+ */
+std::shared_ptr<const Ruleset> Ruleset::compressEquivalentModules(const std::shared_ptr<const Ruleset>& ruleset) {
+    int moduleCount = ruleset->getModuleCount();
+
+    // 按邻接行分组，保持模块首次出现的顺序；键为四个方向的有序索引列表，方向之间以 -1 分隔，最后是类别
+    std::map<std::vector<int>, int> classByRows;
+    std::vector<std::vector<int>> members;
+    std::vector<int> classOf(moduleCount);
+    for (int m = 0; m < moduleCount; ++m) {
+        std::vector<int> rows;
+        for (int dir = 0; dir < COUNT; ++dir) {
+            ruleset->forEachCompatible(m, dir, [&rows](int n) { rows.push_back(n); });
+            rows.push_back(-1);
+        }
+        rows.push_back(ruleset->getCategoryOf(m));
+        auto it = classByRows.find(rows);
+        if (it == classByRows.end()) {
+            it = classByRows.emplace(std::move(rows), static_cast<int>(members.size())).first;
+            members.emplace_back();
+        }
+        members[it->second].push_back(m);
+        classOf[m] = it->second;
+    }
+
+    int classCount = static_cast<int>(members.size());
+    if (classCount == moduleCount) {
+        return ruleset;
+    }
+
+    std::shared_ptr<Ruleset> compressed(new Ruleset());
+    compressed->parent = ruleset;
+    compressed->classMembers = members;
+    compressed->classOfParent = classOf;
+    compressed->wordsPerDomain = wordsForBits(classCount);
+
+    // 每个等价类用一个代表模块表示：ID 由成员ID拼接，权重为成员权重之和，瓦片取第一个成员
+    for (int c = 0; c < classCount; ++c) {
+        const Module& first = ruleset->getModule(members[c][0]);
+        std::string id = first.id;
+        double weight = 0.0;
+        for (size_t i = 0; i < members[c].size(); ++i) {
+            if (i > 0) id += "|" + ruleset->getModule(members[c][i]).id;
+            weight += ruleset->getWeight(members[c][i]);
+        }
+        Module representative(id, weight);
+        representative.tileIndex = first.tileIndex;
+        representative.category = first.category;
+        compressed->modules.push_back(representative);
+        compressed->weights.push_back(weight);
+        compressed->tileIndices.push_back(first.tileIndex);
+        compressed->moduleIndices[id] = c;
+        for (int member : members[c]) {
+            compressed->moduleIndices[ruleset->getModule(member).id] = c;
+        }
+    }
+
+    // 等价类之间的兼容关系取自代表成员，同时补全代表模块的邻接规则
+    std::vector<std::vector<int>> lists(static_cast<size_t>(classCount) * COUNT);
+    for (int c = 0; c < classCount; ++c) {
+        for (int dir = 0; dir < COUNT; ++dir) {
+            std::vector<int>& list = lists[static_cast<size_t>(c) * COUNT + dir];
+            std::set<std::string>& allowed = compressed->modules[c].adjacencyRules[static_cast<Direction>(dir)];
+            ruleset->forEachCompatible(members[c][0], dir, [&](int other) {
+                int d = classOf[other];
+                if (members[d][0] == other) {
+                    list.push_back(d);
+                    allowed.insert(compressed->modules[d].id);
+                }
+            });
+            std::sort(list.begin(), list.end());
+        }
+    }
+    compressed->buildCompatibility(lists);
+    compressed->buildCategories();
+
+    std::cout << "Ruleset compressed: " << moduleCount << " modules -> " << classCount << " equivalence classes." << std::endl;
+    return compressed;
+}
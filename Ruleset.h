@@ -0,0 +1,237 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <map>
+#include <set>
+#include <memory>
+#include <unordered_map>
+#include <cstdint>
+#include <SFML/System/Vector2.hpp>
+#include "BitUtils.h"
+
+/**
+ * @brief 定义四个基本方向。
+ * COUNT 用于获取方向的总数。
+ */
+enum Direction {
+    TOP,    // 上
+    BOTTOM, // 下
+    LEFT,   // 左
+    RIGHT,  // 右
+    COUNT   // 方向总数
+};
+
+// 辅助函数声明
+std::string directionToString(Direction dir);
+
+/**
+ * @class Module
+ * @brief 代表一个生成单元（或瓦片）。
+ * 每个模块都有其独特的ID、权重、邻接规则和在瓦片集上的位置。
+ */
+class Module {
+public:
+    std::string id;                                     // 模块的唯一标识符
+    double weight;                                      // 模块在选择时的权重，影响其出现频率
+    std::map<Direction, std::set<std::string>> adjacencyRules; // 邻接规则，定义了在各个方向上可以与哪些模块ID相邻
+    sf::Vector2i tileIndex;                             // 模块在瓦片集（tileset）纹理上的索引坐标
+    std::string category;                               // 模块所属的类别（JSON 中的 class 标签），为空表示未分类
+
+    /**
+     * @brief Module 构造函数。
+     * @param id 模块ID。
+     * @param weight 模块权重。
+     */
+    Module(std::string id, double weight) : id(id), weight(weight), tileIndex(0, 0) {}
+
+    /**
+     * @brief 检查当前模块是否可以在指定方向上与另一个模块兼容。
+     * 兼容性是双向的：A的上方必须能接B，同时B的下方也必须能接A。
+     * @param dir 相对于当前模块的方向。
+     * @param otherModule 要检查兼容性的另一个模块。
+     * @return 如果兼容则返回 true，否则返回 false。
+     */
+    bool isCompatible(Direction dir, const Module& otherModule) const {
+        Direction oppositeDir;
+        if (dir == TOP) oppositeDir = BOTTOM;
+        else if (dir == BOTTOM) oppositeDir = TOP;
+        else if (dir == LEFT) oppositeDir = RIGHT;
+        else oppositeDir = LEFT;
+
+        // 检查双方是否都定义了对应方向的规则
+        if (adjacencyRules.count(dir) == 0 || otherModule.adjacencyRules.count(oppositeDir) == 0) {
+            return false;
+        }
+
+        // 检查规则是否相互匹配
+        return adjacencyRules.at(dir).count(otherModule.id) &&
+            otherModule.adjacencyRules.at(oppositeDir).count(this->id);
+    }
+};
+
+/**
+ * @class Ruleset
+ * @brief 编译后的只读规则集。
+ * 由模块列表一次性编译得到：模块ID被映射为连续索引，邻接规则被编译为按方向的兼容行，
+ * 同时缓存权重和瓦片索引。每一行按填充密度选择稠密位集或有序索引列表（CSR）存储，
+ * 因此超大瓦片集的内存和传播开销随允许的模块对数量增长，而不是模块数量的平方。规则集创建后不可修改，可通过 std::shared_ptr<const Ruleset>
+ * 被任意数量的生成器（包括不同线程中的生成器）共享，无需各自复制规则。
+ */
+class Ruleset {
+public:
+    /**
+     * @brief 从模块列表编译规则集。
+     * @param modules 模块列表。
+     * @return 编译后的只读规则集。
+     */
+    static std::shared_ptr<const Ruleset> compile(const std::vector<Module>& modules);
+
+    /**
+     * @brief 合并邻接完全相同的模块，得到压缩后的规则集。
+     * 如果两个模块在四个方向上的兼容掩码都相同，它们在任何位置都可以互相替换，
+     * 因此被合并为一个等价类，等价类的权重为成员权重之和。生成器在压缩后的字母表上求解，
+     * 坍缩完成后再按权重把每个等价类展开为具体的成员模块。
+     * 注意比较的是编译后的双向兼容关系，而不是 JSON 中的原始列表。
+     * @param ruleset 原始规则集。
+     * @return 压缩后的规则集；没有可合并的模块时直接返回原规则集。
+     */
+    static std::shared_ptr<const Ruleset> compressEquivalentModules(const std::shared_ptr<const Ruleset>& ruleset);
+
+    int getModuleCount() const { return static_cast<int>(modules.size()); }
+    int getWordsPerDomain() const { return wordsPerDomain; }
+    const std::vector<Module>& getModules() const { return modules; }
+    const Module& getModule(int index) const { return modules[index]; }
+    double getWeight(int index) const { return weights[index]; }
+    sf::Vector2i getTileIndex(int index) const { return tileIndices[index]; }
+
+    /**
+     * @brief 根据模块ID查找模块索引。
+     * @param id 模块ID。
+     * @return 模块索引，找不到时返回 -1。
+     */
+    int findModule(const std::string& id) const;
+
+    // 压缩规则集的等价类信息；未压缩的规则集 getParent() 返回空
+    bool isCompressed() const { return parent != nullptr; }
+    const std::shared_ptr<const Ruleset>& getParent() const { return parent; }
+    const std::vector<int>& getClassMembers(int index) const { return classMembers[index]; }
+    int getClassOf(int parentModule) const { return classOfParent[parentModule]; }
+
+    // 兼容行：模块 n 出现在行 (module, dir) 中表示 n 可以放在该模块的 dir 方向上（双向检查，见 Module::isCompatible）
+
+    /**
+     * @brief 获取稠密存储的兼容行。
+     * @return 指向 getWordsPerDomain() 个字的掩码；该行以索引列表存储时返回 nullptr。
+     */
+    const uint64_t* getDenseRow(int module, int dir) const {
+        const CompatibilityRow& row = rows[static_cast<size_t>(module) * COUNT + dir];
+        return row.dense ? denseWords.data() + row.offset : nullptr;
+    }
+
+    /**
+     * @brief 获取以有序索引列表存储的兼容行。
+     * @param count [out] 列表长度。
+     * @return 指向有序模块索引的指针；该行以稠密位集存储时返回 nullptr。
+     */
+    const int* getSparseRow(int module, int dir, int& count) const {
+        const CompatibilityRow& row = rows[static_cast<size_t>(module) * COUNT + dir];
+        count = static_cast<int>(row.count);
+        return row.dense ? nullptr : sparseIndices.data() + row.offset;
+    }
+
+    // 兼容行中允许的模块数量
+    int getCompatibleCount(int module, int dir) const { return static_cast<int>(rows[static_cast<size_t>(module) * COUNT + dir].count); }
+
+    /**
+     * @brief 把兼容行按位或到掩码中，两种存储方式都适用。
+     * @param mask 指向 getWordsPerDomain() 个字的掩码。
+     */
+    void orCompatibility(int module, int dir, uint64_t* mask) const {
+        const CompatibilityRow& row = rows[static_cast<size_t>(module) * COUNT + dir];
+        if (row.count == 0) return; // 空行可能位于数组末尾，不能取下标
+        if (row.dense) {
+            const uint64_t* words = denseWords.data() + row.offset;
+            for (int w = 0; w < wordsPerDomain; ++w) mask[w] |= words[w];
+        }
+        else {
+            const int* indices = sparseIndices.data() + row.offset;
+            for (uint32_t i = 0; i < row.count; ++i) mask[indices[i] / 64] |= uint64_t(1) << (indices[i] % 64);
+        }
+    }
+
+    /**
+     * @brief 依次访问兼容行中允许的模块（按索引升序）。
+     */
+    template <typename Visitor>
+    void forEachCompatible(int module, int dir, Visitor visit) const {
+        const CompatibilityRow& row = rows[static_cast<size_t>(module) * COUNT + dir];
+        if (row.count == 0) return; // 空行可能位于数组末尾，不能取下标
+        if (row.dense) {
+            const uint64_t* words = denseWords.data() + row.offset;
+            for (int w = 0; w < wordsPerDomain; ++w) {
+                for (uint64_t bits = words[w]; bits; bits &= bits - 1) visit(w * 64 + lowestBitIndex(bits));
+            }
+        }
+        else {
+            const int* indices = sparseIndices.data() + row.offset;
+            for (uint32_t i = 0; i < row.count; ++i) visit(indices[i]);
+        }
+    }
+
+    // 检查模块 other 是否可以放在 module 的 dir 方向上
+    bool isCompatibleIndex(int module, int dir, int other) const;
+
+    // 模块类别：同一类别的模块共享一个类别索引，未分类的模块归入同一个空类别。
+    // 类别之间的兼容关系是模块兼容关系的上界：类别 A 的某个成员允许类别 B 的某个成员时，A 就允许 B。
+    // 至少有两个、至多 64 个类别时 hasCategories() 为 true，类别集合可以用一个 64 位字表示。
+    bool hasCategories() const { return categoryCount > 1; }
+    int getCategoryCount() const { return categoryCount; }
+    int getCategoryOf(int module) const { return categoryOf[module]; }
+    const std::string& getCategoryName(int category) const { return categoryNames[category]; }
+
+    // 某类别全部成员模块的位集，指向 getWordsPerDomain() 个字
+    const uint64_t* getCategoryMask(int category) const { return &categoryMasks[static_cast<size_t>(category) * wordsPerDomain]; }
+
+    // 某类别在 dir 方向上允许的类别集合，第 c 位表示类别 c
+    uint64_t getCategorySupport(int category, int dir) const { return categorySupport[category * COUNT + dir]; }
+
+    // 兼容行占用的字节数
+    size_t getCompatibilityBytes() const {
+        return rows.size() * sizeof(CompatibilityRow) + denseWords.size() * sizeof(uint64_t) + sparseIndices.size() * sizeof(int);
+    }
+
+private:
+    /**
+     * @struct CompatibilityRow
+     * @brief 一个 (模块, 方向) 兼容行的存储位置。
+     */
+    struct CompatibilityRow {
+        uint32_t offset;    // 稠密行在 denseWords 中的起始字，或索引列表在 sparseIndices 中的起点
+        uint32_t count;     // 允许的模块数量
+        bool dense;         // 是否以稠密位集存储
+    };
+
+    Ruleset() = default;
+
+    void buildCompatibility(const std::vector<std::vector<int>>& lists); // 由每行的有序索引列表建立兼容行
+    void buildCategories();                                              // 由模块的类别标签建立类别掩码和类别兼容关系
+
+    std::vector<Module> modules;                        // 模块列表，下标即模块索引
+    std::unordered_map<std::string, int> moduleIndices; // 模块ID到索引的映射
+    std::vector<double> weights;                        // 各模块的权重
+    std::vector<sf::Vector2i> tileIndices;              // 各模块在瓦片集上的坐标
+    int wordsPerDomain = 0;                             // 每个位集占用的 64 位字数
+    std::vector<CompatibilityRow> rows;                 // 兼容行，按 [模块 * 4 + 方向] 排列
+    std::vector<uint64_t> denseWords;                   // 稠密行的位集
+    std::vector<int> sparseIndices;                     // 索引列表行的有序模块索引
+    int categoryCount = 0;                              // 可用于类别级传播的类别数量，不满足条件时为 0
+    std::vector<std::string> categoryNames;             // 各类别的名称
+    std::vector<int> categoryOf;                        // 各模块所属的类别
+    std::vector<uint64_t> categoryMasks;                // 各类别成员模块的位集，按 [类别][字] 排列
+    std::vector<uint64_t> categorySupport;              // 类别兼容关系，按 [类别 * 4 + 方向] 排列
+
+    std::shared_ptr<const Ruleset> parent;              // 被压缩的原始规则集
+    std::vector<std::vector<int>> classMembers;         // 每个等价类包含的原始模块索引
+    std::vector<int> classOfParent;                     // 原始模块所属的等价类
+};
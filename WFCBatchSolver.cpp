@@ -0,0 +1,325 @@
+#include "WFCBatchSolver.h"
+#include "WFCGenerator.h"
+#include <iostream>
+
+/**
+ * @brief WFCBatchSolver 构造函数。
+ * 预先计算每个方向上支持某模块的模块列表和单元格的邻居索引。
+ */
+WFCBatchSolver::WFCBatchSolver(int width, int height, std::shared_ptr<const Ruleset> ruleset)
+    : width(width), height(height), cellCount(width * height), ruleset(std::move(ruleset)) {
+    moduleCount = this->ruleset->getModuleCount();
+
+    // 支持列表 (dir, k) 列出所有在 dir 方向上允许放置 k 的模块，所有列表连续存放
+    supporterStarts.assign(static_cast<size_t>(COUNT) * moduleCount + 1, 0);
+    for (int dir = 0; dir < COUNT; ++dir) {
+        for (int m = 0; m < moduleCount; ++m) {
+            this->ruleset->forEachCompatible(m, dir, [&](int k) { supporterStarts[dir * moduleCount + k + 1]++; });
+        }
+    }
+    for (size_t i = 1; i < supporterStarts.size(); ++i) supporterStarts[i] += supporterStarts[i - 1];
+    supporters.resize(supporterStarts.back());
+    std::vector<int> fill(supporterStarts.begin(), supporterStarts.end() - 1);
+    for (int dir = 0; dir < COUNT; ++dir) {
+        for (int m = 0; m < moduleCount; ++m) {
+            this->ruleset->forEachCompatible(m, dir, [&](int k) { supporters[fill[dir * moduleCount + k]++] = m; });
+        }
+    }
+
+    const int dx[] = { 0, 0, -1, 1 }; // TOP, BOTTOM, LEFT, RIGHT
+    const int dy[] = { -1, 1, 0, 0 };
+    neighbors.resize(static_cast<size_t>(cellCount) * COUNT);
+    for (int c = 0; c < cellCount; ++c) {
+        for (int dir = 0; dir < COUNT; ++dir) {
+            int nx = c % width + dx[dir];
+            int ny = c / width + dy[dir];
+            neighbors[c * COUNT + dir] = (nx < 0 || nx >= width || ny < 0 || ny >= height) ? -1 : ny * width + nx;
+        }
+    }
+
+    planes.resize(static_cast<size_t>(cellCount) * moduleCount);
+    domainSizes.resize(static_cast<size_t>(cellCount) * MaxLanes);
+    collapsedLanes.resize(cellCount);
+    dirtyLanes.resize(cellCount);
+    worklist.reserve(cellCount);
+    inWorklist.resize(cellCount);
+    entropyCells.resize(static_cast<size_t>(MaxLanes) * cellCount);
+    entropySlots.resize(static_cast<size_t>(MaxLanes) * cellCount);
+    entropyStarts.resize(static_cast<size_t>(MaxLanes) * (moduleCount + 2));
+    weights.reserve(moduleCount);
+}
+
+/**
+ * @brief 批量求解多个实例。
+ */
+int WFCBatchSolver::solve(const std::vector<unsigned int>& seeds, std::vector<std::vector<int>>& results) {
+    int instanceCount = static_cast<int>(seeds.size());
+    results.assign(instanceCount, std::vector<int>());
+    fallbackCount = 0;
+
+    int solved = 0;
+    for (int first = 0; first < instanceCount; first += MaxLanes) {
+        int laneCount = std::min(MaxLanes, instanceCount - first);
+        LaneMask failed = solveGroup(&seeds[first], laneCount, &results[first]);
+
+        // 锁步中出现矛盾的实例退回到标量回溯路径
+        for (int lane = 0; lane < laneCount; ++lane) {
+            if (failed & (1u << lane)) {
+                fallbackCount++;
+                if (!solveScalar(seeds[first + lane], results[first + lane])) {
+                    results[first + lane].clear();
+                    continue;
+                }
+            }
+            solved++;
+        }
+    }
+    return solved;
+}
+
+/**
+ * @brief 锁步求解一组实例。
+ * @param seeds 本组实例的种子。
+ * @param laneCount 本组实例数量。
+ * @param results [out] 本组实例的结果。
+ * @return 出现矛盾、需要补救的实例掩码。
+ */
+WFCBatchSolver::LaneMask WFCBatchSolver::solveGroup(const unsigned int* seeds, int laneCount, std::vector<int>* results) {
+    LaneMask allLanes = static_cast<LaneMask>((1u << laneCount) - 1);
+    std::fill(planes.begin(), planes.end(), allLanes);
+    std::fill(domainSizes.begin(), domainSizes.end(), static_cast<uint16_t>(moduleCount));
+    std::fill(collapsedLanes.begin(), collapsedLanes.end(), 0);
+    std::fill(dirtyLanes.begin(), dirtyLanes.end(), 0);
+    // 所有单元格都位于最高的熵段，第 0 段（已坍缩）和中间各段为空
+    for (int lane = 0; lane < laneCount; ++lane) {
+        laneRngs[lane].seed(seeds[lane]);
+        int* cells = &entropyCells[static_cast<size_t>(lane) * cellCount];
+        int* slots = &entropySlots[static_cast<size_t>(lane) * cellCount];
+        for (int c = 0; c < cellCount; ++c) cells[c] = slots[c] = c;
+        int* starts = &entropyStarts[static_cast<size_t>(lane) * (moduleCount + 2)];
+        std::fill(starts, starts + moduleCount + 1, 0);
+        starts[moduleCount + 1] = cellCount;
+    }
+
+    LaneMask active = allLanes;   // 仍在锁步求解中的实例
+    LaneMask failed = 0;          // 出现矛盾的实例
+
+    while (active) {
+        // 1. 每个实例各自在最低的非空熵段中选择一个单元格，并按权重坍缩
+        int shared = -1;
+        for (int lane = 0; lane < laneCount; ++lane) {
+            LaneMask bit = static_cast<LaneMask>(1u << lane);
+            if (!(active & bit)) continue;
+
+            const int* starts = &entropyStarts[static_cast<size_t>(lane) * (moduleCount + 2)];
+            int entropy = 1;
+            while (entropy <= moduleCount && starts[entropy] == starts[entropy + 1]) entropy++;
+            if (entropy > moduleCount) {
+                active &= ~bit; // 该实例已全部坍缩
+                continue;
+            }
+            // 前一个实例选中的单元格也在本实例的最低熵段中时沿用它，各实例在同一处坍缩，传播才能共用
+            int target = shared;
+            int slot = target >= 0 ? entropySlots[static_cast<size_t>(lane) * cellCount + target] : -1;
+            if (slot < starts[entropy] || slot >= starts[entropy + 1]) {
+                slot = std::uniform_int_distribution<int>(starts[entropy], starts[entropy + 1] - 1)(laneRngs[lane]);
+                target = entropyCells[static_cast<size_t>(lane) * cellCount + slot];
+            }
+            shared = target;
+
+            double totalWeight = 0.0;
+            weights.assign(moduleCount, 0.0);
+            for (int m = 0; m < moduleCount; ++m) {
+                if (planes[static_cast<size_t>(target) * moduleCount + m] & bit) {
+                    weights[m] = ruleset->getWeight(m);
+                    totalWeight += weights[m];
+                }
+            }
+            double r = std::uniform_real_distribution<double>(0.0, totalWeight)(laneRngs[lane]);
+            int chosen = -1;
+            for (int m = 0; m < moduleCount; ++m) {
+                if (weights[m] <= 0.0) continue;
+                chosen = m;
+                r -= weights[m];
+                if (r < 0.0) break;
+            }
+
+            for (int m = 0; m < moduleCount; ++m) {
+                if (m != chosen) removeLanes(target, m, bit, failed);
+            }
+            lowerEntropy(lane, target, 1); // 从第 1 段移到第 0 段
+            collapsedLanes[target] |= bit;
+            dirtyLanes[target] |= bit;
+            if (!inWorklist[target]) {
+                inWorklist[target] = 1;
+                worklist.push_back(target);
+            }
+        }
+
+        // 2. 所有实例共用一次传播
+        failed |= propagate(active);
+        active &= ~failed;
+    }
+
+    for (int lane = 0; lane < laneCount; ++lane) {
+        if (!(failed & (1u << lane))) {
+            extractResult(lane, results[lane]);
+        }
+    }
+    return failed;
+}
+
+/**
+ * @brief 在指定实例中移除某单元格的一个模块，并更新这些实例的熵。
+ * @param cell 单元格索引。
+ * @param module 模块索引。
+ * @param lanes 要移除的实例掩码（只处理当前确实包含该模块的实例）。
+ * @param failed [in,out] 可能模块变为空的实例会被加入该掩码。
+ */
+void WFCBatchSolver::removeLanes(int cell, int module, LaneMask lanes, LaneMask& failed) {
+    LaneMask& plane = planes[static_cast<size_t>(cell) * moduleCount + module];
+    LaneMask removed = plane & lanes;
+    if (!removed) return;
+    plane &= ~removed;
+    for (LaneMask bits = removed; bits; bits &= bits - 1) {
+        int lane = lowestBitIndex(bits);
+        int size = --domainSizes[cell * MaxLanes + lane];
+        if (size == 0) {
+            failed |= static_cast<LaneMask>(1u << lane);
+        }
+        else if (!(collapsedLanes[cell] & (1u << lane))) {
+            lowerEntropy(lane, cell, size + 1);
+        }
+    }
+}
+
+/**
+ * @brief 单元格在某实例中的熵减一后，把它移到下一个较低段。
+ * 与本段开头的单元格交换，再把段起点后移，单元格就落入较低段的末尾（与 WFCGenerator 的熵分段相同）。
+ * 坍缩时单元格从第 1 段移到第 0 段，之后不再移动。
+ * @param lane 实例。
+ * @param cell 单元格索引。
+ * @param entropy 单元格当前所在的段（减一之前的熵）。
+ */
+void WFCBatchSolver::lowerEntropy(int lane, int cell, int entropy) {
+    int* cells = &entropyCells[static_cast<size_t>(lane) * cellCount];
+    int* slots = &entropySlots[static_cast<size_t>(lane) * cellCount];
+    int* starts = &entropyStarts[static_cast<size_t>(lane) * (moduleCount + 2)];
+    int from = slots[cell];
+    int slot = starts[entropy]++;
+    int other = cells[slot];
+    cells[from] = other;
+    slots[other] = from;
+    cells[slot] = cell;
+    slots[cell] = slot;
+}
+
+/**
+ * @brief 对所有实例同时传播约束。
+ * 邻居模块 k 在各实例中的支持 = 当前单元格中所有支持 k 的模块的实例掩码之并，
+ * 因此一次按位或/与就完成了整组实例的检查。
+ * @param active 仍在求解中的实例。
+ * @return 传播中出现矛盾的实例。
+ */
+WFCBatchSolver::LaneMask WFCBatchSolver::propagate(LaneMask active) {
+    LaneMask failed = 0;
+    while (!worklist.empty()) {
+        int current = worklist.back();
+        worklist.pop_back();
+        inWorklist[current] = 0;
+        LaneMask dirty = dirtyLanes[current] & active & ~failed;
+        dirtyLanes[current] = 0;
+        if (!dirty) continue;
+
+        const LaneMask* currentPlanes = &planes[static_cast<size_t>(current) * moduleCount];
+        for (int dir = 0; dir < COUNT; ++dir) {
+            int neighbor = neighbors[current * COUNT + dir];
+            if (neighbor < 0) continue;
+            // 已坍缩的邻居不必检查：它的坍缩已经（或即将）传播到当前单元格，
+            // 当前单元格剩余的模块都与它兼容，失去支持只会表现为当前单元格变空
+            LaneMask lanes = dirty & ~failed & ~collapsedLanes[neighbor];
+            if (!lanes) continue;
+
+            LaneMask changed = 0;
+            for (int k = 0; k < moduleCount; ++k) {
+                // 支持列表很短，整段按位或比逐个判断能否提前结束更快（分支难以预测）
+                LaneMask support = 0;
+                const int* list = &supporters[0];
+                for (int i = supporterStarts[dir * moduleCount + k], end = supporterStarts[dir * moduleCount + k + 1]; i < end; ++i) {
+                    support |= currentPlanes[list[i]];
+                }
+                LaneMask unsupported = planes[static_cast<size_t>(neighbor) * moduleCount + k] & lanes & ~support;
+                if (unsupported) {
+                    removeLanes(neighbor, k, unsupported, failed);
+                    changed |= unsupported;
+                }
+            }
+
+            changed &= ~failed;
+            if (changed) {
+                dirtyLanes[neighbor] |= changed;
+                if (!inWorklist[neighbor]) {
+                    inWorklist[neighbor] = 1;
+                    worklist.push_back(neighbor);
+                }
+            }
+        }
+    }
+    return failed;
+}
+
+/**
+ * @brief 读取一个实例的结果，压缩规则集的等价类在这里展开为原始模块。
+ */
+void WFCBatchSolver::extractResult(int lane, std::vector<int>& result) {
+    result.assign(cellCount, -1);
+    LaneMask bit = static_cast<LaneMask>(1u << lane);
+    for (int c = 0; c < cellCount; ++c) {
+        for (int m = 0; m < moduleCount; ++m) {
+            if (planes[static_cast<size_t>(c) * moduleCount + m] & bit) {
+                result[c] = expandModule(m, laneRngs[lane]);
+                break;
+            }
+        }
+    }
+}
+
+/**
+ * @brief 用标量回溯求解器求解单个实例。
+ */
+bool WFCBatchSolver::solveScalar(unsigned int seed, std::vector<int>& result) {
+    if (!fallbackGenerator) {
+        fallbackGenerator = std::make_unique<WFCGenerator>(width, height, ruleset);
+        WFCOptions options;
+        options.headless = true;
+        fallbackGenerator->setOptions(options);
+    }
+    fallbackGenerator->reset(seed);
+    if (!fallbackGenerator->generate()) {
+        return false;
+    }
+    result.assign(cellCount, -1);
+    for (int y = 0; y < height; ++y) {
+        for (int x = 0; x < width; ++x) {
+            result[y * width + x] = fallbackGenerator->getModuleIndex(x, y);
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief 把压缩规则集的等价类按成员权重展开为原始模块。
+ */
+int WFCBatchSolver::expandModule(int module, std::mt19937& rng) const {
+    if (!ruleset->isCompressed()) {
+        return module;
+    }
+    const Ruleset& original = *ruleset->getParent();
+    const std::vector<int>& members = ruleset->getClassMembers(module);
+    double r = std::uniform_real_distribution<double>(0.0, ruleset->getWeight(module))(rng);
+    for (int member : members) {
+        r -= original.getWeight(member);
+        if (r < 0.0) return member;
+    }
+    return members.back();
+}
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <vector>
+#include <memory>
+#include <random>
+#include <cstdint>
+#include "Ruleset.h"
+#include "BitUtils.h"
+#include "WFCGenerator.h"
+
+/**
+ * @class WFCBatchSolver
+ * @brief 同一规则集下大量小地图的锁步批量求解器。
+ * 最多 16 个实例组成一组同时求解：可能模块按 [单元格][模块] 存储为 16 位的实例掩码，
+ * 第 l 位表示该模块在第 l 个实例中仍然可能。每一步各实例各自坍缩一个单元格，然后共用一次传播，
+ * 传播中的支持计算和剔除都是对整组实例的按位运算。每个实例按熵分段排列未坍缩的单元格，
+ * 选择最低熵单元格不需要扫描网格；前一个实例选中的单元格同样是本实例的最低熵时沿用它，
+ * 让各实例尽量在同一处坍缩、共用传播。锁步求解不回溯，出现矛盾的实例退回到 WFCGenerator 的
+ * 标量回溯路径重新求解，补救用的生成器在多次求解之间复用。不支持全局数量上限。
+ */
+class WFCBatchSolver {
+public:
+    using LaneMask = uint16_t;                          // 一组实例的位掩码
+    static constexpr int MaxLanes = 16;                 // 每组最多的实例数
+
+    /**
+     * @brief WFCBatchSolver 构造函数。
+     * @param width 网格宽度。
+     * @param height 网格高度。
+     * @param ruleset 共享的只读规则集（可以是压缩规则集）。
+     */
+    WFCBatchSolver(int width, int height, std::shared_ptr<const Ruleset> ruleset);
+
+    /**
+     * @brief 批量求解多个实例。
+     * 实例按 MaxLanes 个一组锁步求解，锁步失败的实例用标量回溯求解器补救。
+     * @param seeds 每个实例的随机种子，决定实例数量。
+     * @param results [out] 每个实例的结果，按 y * width + x 排列的模块索引（压缩规则集时为原始模块索引），
+     *                无解的实例结果为空。
+     * @return 成功求解的实例数量。
+     */
+    int solve(const std::vector<unsigned int>& seeds, std::vector<std::vector<int>>& results);
+
+    /**
+     * @brief 获取上一次 solve() 中退回到标量回溯路径的实例数量。
+     */
+    int getFallbackCount() const { return fallbackCount; }
+
+private:
+    int width, height;                                  // 网格尺寸
+    int cellCount;                                      // 单元格数量
+    int moduleCount;                                    // 规则集字母表大小
+    std::shared_ptr<const Ruleset> ruleset;             // 共享的只读规则集
+    std::vector<int> supporterStarts;                   // [方向 * moduleCount + k]：支持列表在 supporters 中的起点，最后一项为总长度
+    std::vector<int> supporters;                        // 所有支持列表：在该方向上允许放置模块 k 的模块
+    std::vector<int> neighbors;                         // [单元格 * 4 + 方向]：邻居索引，越界为 -1
+
+    // 一组实例的运行状态，按实例交错存储
+    std::vector<LaneMask> planes;                       // [单元格 * moduleCount + 模块]：模块仍可能的实例
+    std::vector<uint16_t> domainSizes;                  // [单元格 * MaxLanes + 实例]：剩余可能模块数量
+    std::vector<LaneMask> collapsedLanes;               // [单元格]：已坍缩的实例
+    std::vector<LaneMask> dirtyLanes;                   // [单元格]：需要向外传播的实例
+    std::vector<int> worklist;                          // 传播工作队列
+    std::vector<char> inWorklist;                       // 标记单元格是否在队列中
+    std::vector<int> entropyCells;                      // [实例 * cellCount + 位置]：按熵分段排列的单元格，第 0 段为已坍缩
+    std::vector<int> entropySlots;                      // [实例 * cellCount + 单元格]：单元格在 entropyCells 中的位置
+    std::vector<int> entropyStarts;                     // [实例 * (moduleCount + 2) + 熵]：各段的起点，最后一项为 cellCount
+    std::vector<double> weights;                        // 坍缩时的候选模块权重
+    std::unique_ptr<WFCGenerator> fallbackGenerator;    // 补救用的标量生成器，首次补救时创建
+    std::mt19937 laneRngs[MaxLanes];                    // 各实例的随机数生成器
+    int fallbackCount = 0;                              // 上一次求解中的补救实例数量
+
+    LaneMask solveGroup(const unsigned int* seeds, int laneCount, std::vector<int>* results); // 锁步求解一组实例
+    void removeLanes(int cell, int module, LaneMask lanes, LaneMask& failed); // 在指定实例中移除某单元格的模块
+    void lowerEntropy(int lane, int cell, int entropy); // 单元格在某实例中的熵减一后把它移到下一个较低段
+    LaneMask propagate(LaneMask active);                // 对所有实例同时传播，返回出现矛盾的实例
+    void extractResult(int lane, std::vector<int>& result); // 读取一个实例的结果
+    bool solveScalar(unsigned int seed, std::vector<int>& result); // 用标量回溯求解器求解单个实例
+    int expandModule(int module, std::mt19937& rng) const; // 把压缩规则集的等价类展开为原始模块
+};
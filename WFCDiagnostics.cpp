@@ -0,0 +1,409 @@
+#include "WFCDiagnostics.h"
+#include <algorithm>
+
+/**
+ * @brief WFCDiagnostics 构造函数。
+ * 预先计算每个模块在各方向上的兼容掩码。
+ */
+WFCDiagnostics::WFCDiagnostics(std::shared_ptr<const Ruleset> ruleset, long long nodeBudget)
+    : ruleset(ruleset->isCompressed() ? ruleset->getParent() : ruleset), nodeBudget(nodeBudget) {
+    moduleCount = this->ruleset->getModuleCount();
+    wordsPerDomain = this->ruleset->getWordsPerDomain();
+    rowMasks.assign(static_cast<size_t>(moduleCount) * COUNT * wordsPerDomain, 0);
+    for (int m = 0; m < moduleCount; ++m) {
+        for (int dir = 0; dir < COUNT; ++dir) {
+            this->ruleset->orCompatibility(m, dir, &rowMasks[(static_cast<size_t>(m) * COUNT + dir) * wordsPerDomain]);
+        }
+    }
+    limits.assign(moduleCount, -1);
+}
+
+/**
+ * @brief 设置特定模块在整个网格中的数量上限，找不到的模块ID被忽略。
+ */
+void WFCDiagnostics::setGlobalModuleLimit(const std::string& moduleId, int limit) {
+    int module = ruleset->findModule(moduleId);
+    if (module >= 0) {
+        limits[module] = std::max(0, limit);
+    }
+}
+
+/**
+ * @brief 诊断给定尺寸的地图为什么无解。
+ * 1. 由小到大求解放得进目标地图的矩形探测网格，第一个无解的网格缩减为最小冲突集；
+ * 2. 在 3x3 网格上找出不能出现、以及不能位于内部的模块，并说明原因；
+ * 3. 检查全局上限能否填满地图内部；
+ * 4. 在小环面上寻找周期解，证明不考虑全局上限时任意尺寸都有解。
+ */
+DiagnosticReport WFCDiagnostics::diagnose(int width, int height) {
+    DiagnosticReport report;
+    totalNodes = 0;
+    auto log = [&](const std::string& line) { report.lines.push_back(line); };
+    auto sizeName = [](int w, int h) { return std::to_string(w) + "x" + std::to_string(h); };
+    std::vector<int> noLimits(moduleCount, -1);
+    log("Diagnosing " + sizeName(width, height) + " map with " + std::to_string(moduleCount) + " modules.");
+
+    // 1. 矩形探测网格：子矩形无解即证明目标地图无解
+    std::vector<std::pair<int, int>> sizes = { { 1, 1 }, { 2, 1 }, { 1, 2 }, { 2, 2 }, { 3, 2 }, { 2, 3 }, { 3, 3 },
+        { std::min(width, 8), 1 }, { 1, std::min(height, 8) }, { std::min(width, 8), 2 }, { 2, std::min(height, 8) } };
+    if (width * height <= 16) sizes.push_back({ width, height }); // 整张地图足够小时直接精确求解
+    std::vector<std::pair<int, int>> tried;
+    for (const auto& size : sizes) {
+        if (size.first > width || size.second > height) continue;
+        if (std::find(tried.begin(), tried.end(), size) != tried.end()) continue;
+        tried.push_back(size);
+
+        // 不小于探测网格单元格数的上限不会起作用
+        Probe target = makeProbe(size.first, size.second, false);
+        int cellCount = size.first * size.second;
+        std::vector<int> probeLimits(moduleCount, -1);
+        for (int m = 0; m < moduleCount; ++m) {
+            if (limits[m] >= 0 && limits[m] < cellCount) probeLimits[m] = limits[m];
+        }
+        std::vector<char> edges(target.edges.size(), 1);
+        ProbeResult result = solve(target, edges, probeLimits, -1, -1, nullptr);
+        if (result == ProbeResult::Unknown) {
+            log("Probe " + target.name + ": undecided (node budget exhausted).");
+            continue;
+        }
+        if (result == ProbeResult::Satisfiable) {
+            log("Probe " + target.name + ": satisfiable.");
+            continue;
+        }
+
+        log("Probe " + target.name + ": UNSATISFIABLE, so every larger map is too.");
+        shrinkCore(target, edges, probeLimits, -1, -1);
+        report.unsatisfiable = true;
+        report.failingProbe = target.name;
+        for (size_t e = 0; e < target.edges.size(); ++e) {
+            if (edges[e]) report.coreRules.push_back(describeEdge(target, target.edges[e]));
+        }
+        for (int m = 0; m < moduleCount; ++m) {
+            if (probeLimits[m] >= 0) report.coreLimits.push_back(describeLimit(m));
+        }
+        log("Minimal conflict (" + std::to_string(report.coreRules.size()) + " adjacencies, "
+            + std::to_string(report.coreLimits.size()) + " limits):");
+        for (const std::string& rule : report.coreRules) log("  adjacency " + rule);
+        for (const std::string& limit : report.coreLimits) log("  limit " + limit);
+        break;
+    }
+
+    // 2. 3x3 网格上每个模块能否出现、能否位于中心（不考虑全局上限）
+    std::vector<char> interior(moduleCount, 1);
+    if (width >= 3 && height >= 3) {
+        Probe target = makeProbe(3, 3, false);
+        const int center = 4;
+        std::vector<char> edges(target.edges.size(), 1);
+        std::vector<char> anywhere(moduleCount, 0);
+        std::vector<int> solution;
+        for (int m = 0; m < moduleCount; ++m) {
+            ProbeResult result = solve(target, edges, noLimits, center, m, &solution);
+            interior[m] = result != ProbeResult::Unsatisfiable; // 未决时不下结论
+            if (result == ProbeResult::Unknown) anywhere[m] = 1;
+            if (result == ProbeResult::Satisfiable) {
+                for (int module : solution) anywhere[module] = 1;
+            }
+        }
+        for (int m = 0; m < moduleCount; ++m) {
+            for (int cell = 0; cell < 9 && !anywhere[m]; ++cell) {
+                if (cell == center) continue;
+                ProbeResult result = solve(target, edges, noLimits, cell, m, &solution);
+                if (result == ProbeResult::Unknown) anywhere[m] = 1;
+                if (result == ProbeResult::Satisfiable) {
+                    for (int module : solution) anywhere[module] = 1;
+                }
+            }
+        }
+
+        // 说明原因：列出没有任何兼容模块的方向；仍不足以说明时，把模块固定在空缺方向朝外的位置
+        // （只能出现在边缘的模块固定在中心），给出该位置的最小冲突
+        const size_t maxExplained = 8;
+        size_t explained = 0;
+        for (int m = 0; m < moduleCount; ++m) {
+            if (interior[m]) continue;
+            const std::string& id = ruleset->getModule(m).id;
+            (anywhere[m] ? report.borderOnlyModules : report.unusableModules).push_back(id);
+            std::string line = std::string(anywhere[m] ? "Border-only module " : "Unusable module ") + id + ": ";
+            if (explained++ >= maxExplained) {
+                log(line + "cannot be the center of any 3x3 area.");
+                continue;
+            }
+            std::string sides;
+            int x = 1, y = 1;
+            for (int dir = 0; dir < COUNT; ++dir) {
+                const uint64_t* row = &rowMasks[(static_cast<size_t>(m) * COUNT + dir) * wordsPerDomain];
+                if (!std::all_of(row, row + wordsPerDomain, [](uint64_t word) { return word == 0; })) continue;
+                sides += (sides.empty() ? "" : ", ") + directionToString(static_cast<Direction>(dir));
+                if (dir == TOP) y = 0;
+                else if (dir == BOTTOM) y = 2;
+                else if (dir == LEFT) x = 0;
+                else x = 2;
+            }
+            std::string reason = sides.empty() ? "" : "no module is allowed on its " + sides + " side";
+            if (anywhere[m] && !reason.empty()) {
+                log(line + reason + ".");
+                continue;
+            }
+            if (anywhere[m]) x = y = 1;
+            std::vector<char> core(target.edges.size(), 1);
+            std::vector<int> coreLimits(noLimits);
+            shrinkCore(target, core, coreLimits, y * 3 + x, m);
+            std::string conflict;
+            for (size_t e = 0; e < target.edges.size(); ++e) {
+                if (core[e]) conflict += (conflict.empty() ? "" : "; ") + describeEdge(target, target.edges[e]);
+            }
+            log(line + reason + (reason.empty() ? "" : ", and ") + "placed at (" + std::to_string(x) + "," + std::to_string(y)
+                + ") of a 3x3 area these adjacencies conflict: " + conflict + ".");
+        }
+        if (report.unusableModules.empty() && report.borderOnlyModules.empty()) {
+            log("Every module can be the center of some 3x3 area.");
+        }
+    }
+
+    // 3. 全局上限能否填满需要的单元格：地图内部的单元格只能使用能位于 3x3 中心的模块
+    if (!report.unsatisfiable) {
+        bool interiorOnly = width >= 3 && height >= 3;
+        long long cellsToFill = interiorOnly ? static_cast<long long>(width - 2) * (height - 2) : static_cast<long long>(width) * height;
+        long long capacity = 0;
+        bool bounded = true;
+        for (int m = 0; m < moduleCount && bounded; ++m) {
+            if (!interior[m]) continue;
+            if (limits[m] < 0) bounded = false;
+            else capacity += limits[m];
+        }
+        if (bounded && capacity < cellsToFill) {
+            report.unsatisfiable = true;
+            for (int m = 0; m < moduleCount; ++m) {
+                if (interior[m]) report.coreLimits.push_back(describeLimit(m));
+            }
+            log("Global limits allow at most " + std::to_string(capacity) + " modules for the " + std::to_string(cellsToFill)
+                + (interiorOnly ? " interior cells" : " cells") + "; raising any of these limits removes the conflict:");
+            for (const std::string& limit : report.coreLimits) log("  limit " + limit);
+        }
+    }
+
+    // 4. 环面探测网格：有周期解时平铺即可得到任意尺寸的地图（不考虑全局上限）
+    const std::pair<int, int> periods[] = { { 1, 1 }, { 2, 1 }, { 1, 2 }, { 2, 2 }, { 3, 1 }, { 1, 3 }, { 3, 2 }, { 2, 3 },
+        { 3, 3 }, { 4, 2 }, { 2, 4 }, { 4, 4 } };
+    for (const auto& period : periods) {
+        Probe target = makeProbe(period.first, period.second, true);
+        std::vector<char> edges(target.edges.size(), 1);
+        std::vector<int> solution;
+        if (solve(target, edges, noLimits, -1, -1, &solution) != ProbeResult::Satisfiable) continue;
+        report.periodWidth = period.first;
+        report.periodHeight = period.second;
+        std::vector<int> used(solution);
+        std::sort(used.begin(), used.end());
+        used.erase(std::unique(used.begin(), used.end()), used.end());
+        std::string modules;
+        for (int m : used) modules += (modules.empty() ? "" : ", ") + ruleset->getModule(m).id;
+        log("Periodic pattern " + target.name + " found (" + modules + "): without global limits every map size is solvable.");
+        break;
+    }
+    if (report.periodWidth == 0) {
+        log("No periodic pattern up to 4x4.");
+    }
+
+    bool hasLimits = std::any_of(limits.begin(), limits.end(), [](int limit) { return limit >= 0; });
+    if (!report.failingProbe.empty()) {
+        report.summary = "No solution: even a " + report.failingProbe + " area cannot be filled ("
+            + std::to_string(report.coreRules.size() + report.coreLimits.size()) + " conflicting rules/limits).";
+    }
+    else if (report.unsatisfiable) {
+        report.summary = "No solution: global limits cannot fill the map.";
+    }
+    else if (report.periodWidth > 0) {
+        report.summary = hasLimits
+            ? "Rules are satisfiable for every size; the global limits are the likely cause."
+            : "Rules are satisfiable for every size; the search gave up before finding a solution.";
+    }
+    else {
+        report.summary = "No contradiction on small probes; the conflict needs a larger area.";
+    }
+    log(report.summary);
+    return report;
+}
+
+/**
+ * @brief 建立矩形或环面探测网格。
+ * 矩形只连接网格内的相邻单元格；环面在右边缘和下边缘回绕，宽或高为 1 时单元格与自身相邻。
+ */
+WFCDiagnostics::Probe WFCDiagnostics::makeProbe(int width, int height, bool torus) const {
+    Probe target;
+    target.name = std::to_string(width) + "x" + std::to_string(height) + (torus ? " torus" : "");
+    target.width = width;
+    target.height = height;
+    target.incident.resize(static_cast<size_t>(width) * height);
+    auto addEdge = [&](int from, int to, int dir) {
+        int index = static_cast<int>(target.edges.size());
+        target.edges.push_back({ from, to, dir });
+        target.incident[from].push_back(index);
+        if (to != from) target.incident[to].push_back(index);
+    };
+    for (int y = 0; y < height; ++y) {
+        for (int x = 0; x < width; ++x) {
+            int cell = y * width + x;
+            if (x + 1 < width || torus) addEdge(cell, y * width + (x + 1) % width, RIGHT);
+            if (y + 1 < height || torus) addEdge(cell, ((y + 1) % height) * width + x, BOTTOM);
+        }
+    }
+    return target;
+}
+
+/**
+ * @brief 求解探测网格。
+ * @param target 探测网格。
+ * @param edges [边]：是否约束。
+ * @param moduleLimits [模块]：全局上限，-1 表示不限。
+ * @param fixedCell 固定为 fixedModule 的单元格，-1 表示不固定。
+ * @param fixedModule 固定的模块。
+ * @param solution [out] 有解时写入每个单元格的模块，可以为空。
+ * @return 求解结果。
+ */
+WFCDiagnostics::ProbeResult WFCDiagnostics::solve(const Probe& target, const std::vector<char>& edges, const std::vector<int>& moduleLimits,
+                                                  int fixedCell, int fixedModule, std::vector<int>* solution) {
+    probe = &target;
+    activeEdges = &edges;
+    activeLimits = &moduleLimits;
+    int cellCount = target.width * target.height;
+    size_t layer = static_cast<size_t>(cellCount) * wordsPerDomain;
+    domainStack.assign(layer * (cellCount + 1), 0);
+    assigned.assign(cellCount, -1);
+    counts.assign(moduleCount, 0);
+    nodes = 0;
+
+    for (int c = 0; c < cellCount; ++c) {
+        uint64_t* domain = &domainStack[static_cast<size_t>(c) * wordsPerDomain];
+        for (int m = 0; m < moduleCount; ++m) {
+            if (moduleLimits[m] != 0 && (c != fixedCell || m == fixedModule)) domain[m / 64] |= uint64_t(1) << (m % 64);
+        }
+    }
+    ProbeResult result = search(0);
+    if (result == ProbeResult::Satisfiable && solution) {
+        *solution = assigned;
+    }
+    return result;
+}
+
+/**
+ * @brief 最少剩余值优先的深度优先搜索，第 depth 层的可能模块保存在 domainStack 的第 depth 段。
+ * @return 有解时 assigned 中保留解。
+ */
+WFCDiagnostics::ProbeResult WFCDiagnostics::search(int depth) {
+    if (++nodes > nodeBudget || ++totalNodes > nodeBudget * TotalBudgetFactor) return ProbeResult::Unknown;
+    int cellCount = probe->width * probe->height;
+    size_t layer = static_cast<size_t>(cellCount) * wordsPerDomain;
+    uint64_t* domains = &domainStack[depth * layer];
+
+    int cell = -1;
+    int best = moduleCount + 1;
+    for (int c = 0; c < cellCount; ++c) {
+        if (assigned[c] >= 0) continue;
+        int size = 0;
+        for (int w = 0; w < wordsPerDomain; ++w) size += popCount64(domains[static_cast<size_t>(c) * wordsPerDomain + w]);
+        if (size < best) {
+            best = size;
+            cell = c;
+        }
+    }
+    if (cell < 0) return ProbeResult::Satisfiable;
+
+    uint64_t* next = domains + layer;
+    const uint64_t* choices = domains + static_cast<size_t>(cell) * wordsPerDomain;
+    for (int w = 0; w < wordsPerDomain; ++w) {
+        for (uint64_t bits = choices[w]; bits; bits &= bits - 1) {
+            int m = w * 64 + lowestBitIndex(bits);
+            int limit = (*activeLimits)[m];
+            if (limit >= 0 && counts[m] >= limit) continue;
+            std::copy(domains, domains + layer, next);
+            assigned[cell] = m;
+            counts[m]++;
+            if (restrictNeighbors(next, cell, m)) {
+                ProbeResult result = search(depth + 1);
+                if (result != ProbeResult::Unsatisfiable) return result;
+            }
+            assigned[cell] = -1;
+            counts[m]--;
+        }
+    }
+    return ProbeResult::Unsatisfiable;
+}
+
+/**
+ * @brief 单元格选定模块后收紧相邻单元格的可能模块；模块达到全局上限时从其余单元格中移除。
+ * @return 某个单元格的可能模块变为空，或与已选定的邻居不兼容时返回 false。
+ */
+bool WFCDiagnostics::restrictNeighbors(uint64_t* domains, int cell, int module) {
+    const int opposite[COUNT] = { BOTTOM, TOP, RIGHT, LEFT };
+    uint64_t* own = domains + static_cast<size_t>(cell) * wordsPerDomain;
+    std::fill(own, own + wordsPerDomain, 0);
+    own[module / 64] = uint64_t(1) << (module % 64);
+
+    for (int e : probe->incident[cell]) {
+        if (!(*activeEdges)[e]) continue;
+        const ProbeEdge& edge = probe->edges[e];
+        int other = edge.from == cell ? edge.to : edge.from;
+        int dir = edge.from == cell ? edge.dir : opposite[edge.dir];
+        const uint64_t* allowed = &rowMasks[(static_cast<size_t>(module) * COUNT + dir) * wordsPerDomain];
+        int placed = other == cell ? module : assigned[other];
+        if (placed >= 0) {
+            if (!(allowed[placed / 64] & (uint64_t(1) << (placed % 64)))) return false;
+            continue;
+        }
+        uint64_t* domain = domains + static_cast<size_t>(other) * wordsPerDomain;
+        uint64_t any = 0;
+        for (int w = 0; w < wordsPerDomain; ++w) any |= (domain[w] &= allowed[w]);
+        if (!any) return false;
+    }
+
+    int limit = (*activeLimits)[module];
+    if (limit >= 0 && counts[module] >= limit) {
+        for (int c = 0; c < probe->width * probe->height; ++c) {
+            if (assigned[c] >= 0) continue;
+            uint64_t* domain = domains + static_cast<size_t>(c) * wordsPerDomain;
+            domain[module / 64] &= ~(uint64_t(1) << (module % 64));
+            uint64_t any = 0;
+            for (int w = 0; w < wordsPerDomain; ++w) any |= domain[w];
+            if (!any) return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief 把无解的探测网格缩减为最小冲突集。
+ * 逐个去掉一条相邻关系或一个全局上限，去掉后仍然无解就永久删除。约束越少越容易有解，
+ * 因此结果中任何一项单独去掉都会变得有解（或未决）。
+ * @param edges [in,out] 参与约束的相邻关系。
+ * @param moduleLimits [in,out] 参与约束的全局上限。
+ */
+void WFCDiagnostics::shrinkCore(const Probe& target, std::vector<char>& edges, std::vector<int>& moduleLimits, int fixedCell, int fixedModule) {
+    for (size_t e = 0; e < edges.size(); ++e) {
+        if (!edges[e]) continue;
+        edges[e] = 0;
+        if (solve(target, edges, moduleLimits, fixedCell, fixedModule, nullptr) != ProbeResult::Unsatisfiable) edges[e] = 1;
+    }
+    for (int m = 0; m < moduleCount; ++m) {
+        if (moduleLimits[m] < 0) continue;
+        int limit = moduleLimits[m];
+        moduleLimits[m] = -1;
+        if (solve(target, edges, moduleLimits, fixedCell, fixedModule, nullptr) != ProbeResult::Unsatisfiable) moduleLimits[m] = limit;
+    }
+}
+
+/**
+ * @brief 相邻关系的可读描述，例如 "(0,0) RIGHT (1,0)"。
+ */
+std::string WFCDiagnostics::describeEdge(const Probe& target, const ProbeEdge& edge) const {
+    auto cellName = [&](int cell) {
+        return "(" + std::to_string(cell % target.width) + "," + std::to_string(cell / target.width) + ")";
+    };
+    return cellName(edge.from) + " " + directionToString(static_cast<Direction>(edge.dir)) + " " + cellName(edge.to);
+}
+
+/**
+ * @brief 全局上限的可读描述，例如 "water <= 3"。
+ */
+std::string WFCDiagnostics::describeLimit(int module) const {
+    return ruleset->getModule(module).id + " <= " + std::to_string(limits[module]);
+}
@@ -0,0 +1,119 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <memory>
+#include <cstdint>
+#include "Ruleset.h"
+#include "BitUtils.h"
+
+/**
+ * @struct DiagnosticReport
+ * @brief 规则集诊断的结果。
+ */
+struct DiagnosticReport {
+    bool unsatisfiable = false;                         // 是否证明了目标尺寸的地图无解
+    std::string failingProbe;                           // 第一个无解的探测网格（例如 "2x3"），为空表示没有
+    std::vector<std::string> coreRules;                 // 最小冲突集中的相邻关系
+    std::vector<std::string> coreLimits;                // 最小冲突集中的全局上限
+    int periodWidth = 0;                                // 找到的周期解宽度，0 表示没有找到
+    int periodHeight = 0;                               // 找到的周期解高度
+    std::vector<std::string> unusableModules;           // 不能出现在任何 3x3 区域中的模块
+    std::vector<std::string> borderOnlyModules;         // 不能位于 3x3 区域中心、只能出现在地图边缘的模块
+    std::string summary;                                // 一句话结论
+    std::vector<std::string> lines;                     // 完整的可读报告，逐行输出
+};
+
+/**
+ * @class WFCDiagnostics
+ * @brief 生成失败时的规则集诊断。
+ * 不对整张地图做穷举搜索，而是在几个小探测网格（1x2、2x2、3x3、长条以及环面）上精确求解：
+ * 目标地图的任意子矩形本身也必须有解（全局上限只会更宽松），所以放得进目标地图的探测网格无解
+ * 就证明了目标地图无解，随后逐个删除探测网格中的相邻关系和全局上限，保留仍然无解的部分，
+ * 得到最小冲突集；反过来，环面上有解说明存在周期解，平铺后任意尺寸的地图都有解（不考虑全局上限）。
+ * 3x3 探测网格还给出每个模块能否出现、能否位于内部，并据此检查全局上限能否填满地图内部。
+ * 每次探测都有搜索节点预算，超出预算的探测记为未决，整个诊断在数秒内完成。
+ */
+class WFCDiagnostics {
+public:
+    static const int TotalBudgetFactor = 50;            // 整个诊断的节点预算与单次探测预算之比
+
+    /**
+     * @brief 探测网格的求解结果。
+     */
+    enum class ProbeResult {
+        Satisfiable,    // 有解
+        Unsatisfiable,  // 无解
+        Unknown         // 超出搜索节点预算
+    };
+
+    /**
+     * @brief WFCDiagnostics 构造函数。
+     * @param ruleset 要诊断的规则集；压缩规则集会还原为原始模块，报告中使用模块ID。
+     * @param nodeBudget 每次探测允许的搜索节点数；整个诊断最多使用它的 TotalBudgetFactor 倍，之后的探测都记为未决。
+     */
+    WFCDiagnostics(std::shared_ptr<const Ruleset> ruleset, long long nodeBudget = 200000);
+
+    /**
+     * @brief 设置特定模块在整个网格中的数量上限（与 WFCGenerator::setGlobalModuleLimit 相同）。
+     * @param moduleId 要限制的模块ID。
+     * @param limit 数量上限。
+     */
+    void setGlobalModuleLimit(const std::string& moduleId, int limit);
+
+    /**
+     * @brief 诊断给定尺寸的地图为什么无解。
+     * @param width 目标地图宽度。
+     * @param height 目标地图高度。
+     * @return 诊断报告。
+     */
+    DiagnosticReport diagnose(int width, int height);
+
+private:
+    /**
+     * @struct ProbeEdge
+     * @brief 探测网格中的一条相邻关系：to 位于 from 的 dir 方向上。
+     */
+    struct ProbeEdge {
+        int from;
+        int to;
+        int dir;
+    };
+
+    /**
+     * @struct Probe
+     * @brief 一个探测网格。
+     */
+    struct Probe {
+        std::string name;                               // 报告中的名称，例如 "3x3" 或 "2x2 torus"
+        int width, height;                              // 尺寸
+        std::vector<ProbeEdge> edges;                   // 所有相邻关系（环面包含回绕的边）
+        std::vector<std::vector<int>> incident;         // [单元格]：与该单元格相关的边
+    };
+
+    std::shared_ptr<const Ruleset> ruleset;             // 原始（未压缩）规则集
+    int moduleCount;                                    // 模块数量
+    int wordsPerDomain;                                 // 每个位集的 64 位字数
+    long long nodeBudget;                               // 每次探测的搜索节点预算
+    std::vector<uint64_t> rowMasks;                     // [(模块 * COUNT + 方向) * wordsPerDomain]：兼容掩码
+    std::vector<int> limits;                            // [模块]：全局上限，-1 表示不限
+
+    // 当前探测的搜索状态
+    const Probe* probe = nullptr;                       // 正在求解的探测网格
+    const std::vector<char>* activeEdges = nullptr;     // [边]：是否约束
+    const std::vector<int>* activeLimits = nullptr;     // [模块]：参与约束的全局上限，-1 表示不限
+    std::vector<uint64_t> domainStack;                  // [深度][单元格][字]：每层搜索的可能模块
+    std::vector<int> assigned;                          // [单元格]：已选定的模块，-1 表示未选定
+    std::vector<int> counts;                            // [模块]：已选定的数量
+    long long nodes = 0;                                // 本次探测已展开的节点数
+    long long totalNodes = 0;                           // 本次诊断已展开的节点数
+
+    Probe makeProbe(int width, int height, bool torus) const; // 建立矩形或环面探测网格
+    ProbeResult solve(const Probe& target, const std::vector<char>& edges, const std::vector<int>& moduleLimits,
+                      int fixedCell, int fixedModule, std::vector<int>* solution); // 求解探测网格，可固定一个单元格
+    ProbeResult search(int depth);                      // 最少剩余值优先的深度优先搜索
+    bool restrictNeighbors(uint64_t* domains, int cell, int module); // 选定模块后收紧相邻单元格，出现空集时返回 false
+    void shrinkCore(const Probe& target, std::vector<char>& edges, std::vector<int>& moduleLimits, int fixedCell, int fixedModule); // 逐个删除仍然无解的约束
+    std::string describeEdge(const Probe& target, const ProbeEdge& edge) const; // 相邻关系的可读描述
+    std::string describeLimit(int module) const;        // 全局上限的可读描述
+};
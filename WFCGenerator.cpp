@@ -1,88 +1,152 @@
 #include "WFCGenerator.h"
+#include "BitUtils.h"
+#include "BitPlaneGrid.h"
 #include <iostream>
+#include <future>
+#include <limits>
+#include <cmath>
 
 /**
- * @brief  Direction öתΪַ
- * @param dir Ҫתķö١
- * @return Ӧַʾ
+ * @brief WFCGenerator 构造函数。
+ * @param width 网格宽度。
+ * @param height 网格高度。
+ * @param ruleset 共享的只读规则集。
  */
-std::string directionToString(Direction dir) {
-    switch (dir) {
-    case TOP: return "TOP";
-    case BOTTOM: return "BOTTOM";
-    case LEFT: return "LEFT";
-    case RIGHT: return "RIGHT";
-    default: return "UNKNOWN";
-    }
+WFCGenerator::WFCGenerator(int width, int height, std::shared_ptr<const Ruleset> ruleset)
+    : width(width), height(height), layout(width, height), ruleset(std::move(ruleset)),
+    // 使用当前系统时间作为默认随机数种子，确保每次运行结果不同
+    gen(static_cast<unsigned int>(std::chrono::system_clock::now().time_since_epoch().count())) {
+    moduleCount = this->ruleset->getModuleCount();
+    wordsPerDomain = this->ruleset->getWordsPerDomain();
+    memberCount = this->ruleset->isCompressed() ? this->ruleset->getParent()->getModuleCount() : 0;
+    // 调整网格大小以匹配指定的宽度和高度，单元格在 generate() 开始时才从内存池中创建
+    grid.resize(height, std::vector<Cell*>(width, nullptr));
 }
 
 /**
- * @brief WFCGenerator 캯
- * @param width ȡ
- * @param height ߶ȡ
- * @param modules ɵģб
+ * @brief WFCGenerator 构造函数。
+ * 为给定的模块列表单独编译一份规则集；需要多个生成器时应改用共享规则集的构造函数。
+ * @param width 网格宽度。
+ * @param height 网格高度。
+ * @param modules 用于生成的所有模块的列表。
  */
 WFCGenerator::WFCGenerator(int width, int height, const std::vector<Module>& modules)
-    : width(width), height(height), allModules(modules),
-    // ʹõǰϵͳʱΪĬӣȷÿнͬ
-    gen(static_cast<unsigned int>(std::chrono::system_clock::now().time_since_epoch().count())) {
-    // СƥָĿȺ͸߶
-    grid.resize(height, std::vector<Cell*>(width, nullptr));
-    // ʼ񣬴 Cell 
-    initializeGrid();
+    : WFCGenerator(width, height, Ruleset::compile(modules)) {
 }
 
 /**
- * @brief ӡ
- * @param seed Ҫʹõֵ
+ * @brief 设置随机数生成器的种子。
+ * @param seed 要使用的种子值。
  */
 void WFCGenerator::setSeed(unsigned int seed) {
-    gen.seed(seed); // ʹô
+    gen.seed(seed); // 使用传入的种子重置随机数生成器
+}
+
+/**
+ * @brief 重置生成器以便复用。
+ * 已编译的规则和内存池缓冲区保持不变，运行状态在原缓冲区中重建。
+ * @param seed 要使用的种子值。
+ */
+void WFCGenerator::reset(unsigned int seed) {
+    gen.seed(seed);
+    globalModuleLimits.clear();
+    globalModuleCounts.clear();
+    initializeGrid();
 }
 
 /**
- * @brief WFCGenerator 
- * ̬ Cell 󣬷ֹڴй©
+ * @brief WFCGenerator 析构函数。
+ * 单元格和所有运行状态都位于内存池中，销毁运行状态后由内存池整体释放。
  */
 WFCGenerator::~WFCGenerator() {
-    for (int i = 0; i < height; ++i) {
-        for (int j = 0; j < width; ++j) {
-            delete grid[i][j];
-        }
-    }
+    state.reset();
 }
 
 /**
- * @brief ضģȫޡ
- * @param moduleId ҪƵģID
- * @param limit ޡ
+ * @brief 设置特定模块的全局数量上限。
+ * @param moduleId 要限制的模块ID。
+ * @param limit 数量上限。
  */
 void WFCGenerator::setGlobalModuleLimit(const std::string& moduleId, int limit) {
     globalModuleLimits[moduleId] = limit;
 }
 
 /**
- * @brief ȡڲĳá
- * @return һãָ洢 Cell ָĶά
+ * @brief 使用预先计算的可达掩码表。
+ * @param table 由 ReachabilityTable::compute() 为本生成器的规则集计算的表。
+ */
+void WFCGenerator::setReachabilityTable(std::shared_ptr<const ReachabilityTable> table) {
+    reachability = std::move(table);
+}
+
+/**
+ * @brief 设置求解策略。
+ * @param options 求解策略。
+ */
+void WFCGenerator::setOptions(const WFCOptions& options) {
+    // 单元格排列方式改变后，已经建好的运行状态需要按新的排列重建
+    if (options.cellLayout != this->options.cellLayout || options.layoutTileSize != this->options.layoutTileSize) {
+        layout = GridLayout(width, height, options.cellLayout, options.layoutTileSize);
+        selectionOrder.clear();
+        stateReady = false;
+    }
+    // 位集的存储宽度或 Cell 视图的需求改变后同样需要重建
+    if (selectDomainBits(options) != domainBits || useInterning(options) != interning || options.headless != this->options.headless) {
+        stateReady = false;
+    }
+    this->options = options;
+}
+
+/**
+ * @brief 获取生成器使用的规则集。
+ * @return 共享的只读规则集。
+ */
+const std::shared_ptr<const Ruleset>& WFCGenerator::getRuleset() const {
+    return ruleset;
+}
+
+/**
+ * @brief 获取对内部网格的常量引用。
+ * @return 一个常量引用，指向存储 Cell 指针的二维向量。
  */
 const std::vector<std::vector<Cell*>>& WFCGenerator::getGrid() const {
     return grid;
 }
 
-//  ȡǰиģļӳ䡣
+//  获取当前网格中各模块的计数映射。
 const std::map<std::string, int>& WFCGenerator::getGlobalModuleCounts() const {
     return globalModuleCounts;
 }
 
 /**
- * @brief ڿ̨ӡǰ״̬ڵԣ
- * ̮ĵԪʾģIDδ̮ʾ '?'
+ * @brief 获取结果中模块索引所对应的规则集。
+ * @return 压缩规则集求解成功后为原始规则集，否则为生成器的规则集。
+ */
+const Ruleset& WFCGenerator::getResultRuleset() const {
+    return resultsExpanded ? *ruleset->getParent() : *ruleset;
+}
+
+/**
+ * @brief 获取某个位置坍缩后的模块。
+ * @param x X坐标。
+ * @param y Y坐标。
+ * @return 模块指针，未坍缩时返回 nullptr。
+ */
+const Module* WFCGenerator::getModuleAt(int x, int y) const {
+    int module = getModuleIndex(x, y);
+    return module < 0 ? nullptr : &getResultRuleset().getModule(module);
+}
+
+/**
+ * @brief 在控制台打印当前网格的状态（用于调试）。
+ * 已坍缩的单元格显示其模块ID，未坍缩的显示 '?'。
  */
 void WFCGenerator::printGrid() const {
     for (int i = 0; i < height; ++i) {
         for (int j = 0; j < width; ++j) {
-            if (grid[i][j]->isCollapsed) {
-                std::cout << grid[i][j]->chosenModuleId << "\t";
+            const Module* module = getModuleAt(j, i);
+            if (module) {
+                std::cout << module->id << "\t";
             }
             else {
                 std::cout << "?\t";
@@ -93,322 +157,2053 @@ void WFCGenerator::printGrid() const {
 }
 
 /**
- * @brief ʼΪÿλôһµ Cell 
+ * @brief 计算单元格所有可能模块在某方向上允许的邻居模块并集。
+ * 可能模块不止一个时先查直接映射的缓存；预热阶段命中率过低时，本次生成的剩余部分不再使用缓存。
+ * 缓存由生成器共享，并行求解子问题时只有根搜索使用。
+ * @param ctx 搜索上下文。
+ * @param cellIndex 单元格索引。
+ * @param dir 方向。
+ * @return 指向 wordsPerDomain 个字的并集，在下一次调用前有效。
  */
-void WFCGenerator::initializeGrid() {
-    for (int i = 0; i < height; ++i) {
-        for (int j = 0; j < width; ++j) {
-            grid[i][j] = new Cell(j, i, allModules);
+const uint64_t* WFCGenerator::supportUnion(SearchContext& ctx, int cellIndex, int dir) {
+    // 只剩一个模块且其兼容行以稠密位集存储时，并集就是该行
+    if (domainSize(cellIndex) == 1) {
+        for (int w = 0; w < wordsPerDomain; ++w) {
+            uint64_t bits = domainWord(cellIndex, w);
+            if (!bits) continue;
+            const uint64_t* row = ruleset->getDenseRow(w * 64 + lowestBitIndex(bits), dir);
+            if (row) return row;
+            break;
+        }
+    }
+
+    bool useCache = supportCacheActive && (&ctx == &state->root || !options.parallelComponents);
+    uint64_t* slotKey = nullptr;
+    uint64_t* support = ctx.supportMask.data();
+    int slot = 0;
+    if (useCache) {
+        uint64_t hash = static_cast<uint64_t>(dir + 1) * 0x9E3779B97F4A7C15ULL;
+        for (int w = 0; w < wordsPerDomain; ++w) {
+            hash = (hash ^ domainWord(cellIndex, w)) * 0xBF58476D1CE4E5B9ULL;
+            hash ^= hash >> 31;
+        }
+        slot = static_cast<int>(hash & (supportCacheSlots - 1));
+        slotKey = &supportCacheKeys[static_cast<size_t>(slot) * wordsPerDomain];
+        bool hit = supportCacheDirs[slot] == dir;
+        for (int w = 0; w < wordsPerDomain && hit; ++w) hit = slotKey[w] == domainWord(cellIndex, w);
+        if (hit) {
+            stats.supportCacheHits++;
+            return &supportCacheMasks[static_cast<size_t>(slot) * wordsPerDomain];
+        }
+        stats.supportCacheMisses++;
+        support = &supportCacheMasks[static_cast<size_t>(slot) * wordsPerDomain];
+    }
+
+    std::fill(support, support + wordsPerDomain, 0);
+    for (int w = 0; w < wordsPerDomain; ++w) {
+        for (uint64_t bits = domainWord(cellIndex, w); bits; bits &= bits - 1) {
+            ruleset->orCompatibility(w * 64 + lowestBitIndex(bits), dir, support);
+        }
+    }
+
+    if (useCache) {
+        for (int w = 0; w < wordsPerDomain; ++w) slotKey[w] = domainWord(cellIndex, w);
+        supportCacheDirs[slot] = static_cast<signed char>(dir);
+        // 预热结束时检查命中率，过低则绕过缓存
+        long long lookups = stats.supportCacheHits + stats.supportCacheMisses;
+        if (lookups == supportCacheWarmup && stats.supportCacheHitRate() < options.supportCacheMinHitRate) {
+            supportCacheActive = false;
+            stats.supportCacheBypassed = true;
+            std::cout << "Support cache hit rate " << stats.supportCacheHitRate() << " is too low, bypassing the cache." << std::endl;
         }
     }
+    return support;
 }
 
 /**
- * @brief Ҳ͵δ̮Ԫ
- * ж͵ĵԪѡһ
- * @return ָ͵ĵԪָ룬еԪ̮򷵻 nullptr
+ * @brief 类别级传播：计算跨多个类别的单元格在某方向上允许的邻居模块。
+ * 先求出单元格可能模块覆盖的类别集合，再把这些类别允许的类别的全部成员合并起来。
+ * 代价与类别数量成正比，与类别内的变体数量无关；结果是模块级支持并集的上界，
+ * 单元格只剩一个类别后再由 supportUnion() 在类别内部细化。
+ * @param ctx 搜索上下文。
+ * @param cellIndex 单元格索引。
+ * @param dir 方向。
+ * @return 指向 wordsPerDomain 个字的并集；单元格只有一个类别或可能模块较少时返回 nullptr。
  */
-Cell* WFCGenerator::getLowestEntropyCell() {
-    Cell* lowestEntropyCell = nullptr;
-    size_t minEntropy = -1; // ʹֵʼС
-    std::vector<Cell*> candidates; // 洢͵ĺѡԪ
+const uint64_t* WFCGenerator::categorySupport(SearchContext& ctx, int cellIndex, int dir) {
+    if (domainSize(cellIndex) < options.categoryMinDomain) return nullptr;
 
-    for (int i = 0; i < height; ++i) {
-        for (int j = 0; j < width; ++j) {
-            Cell* cell = grid[i][j];
-            if (!cell->isCollapsed && !cell->possibleModules.empty()) {
-                size_t currentEntropy = cell->calculateEntropy();
-                if (lowestEntropyCell == nullptr || currentEntropy < minEntropy) {
-                    minEntropy = currentEntropy;
-                    candidates.clear();
-                    candidates.push_back(cell);
-                }
-                else if (currentEntropy == minEntropy) {
-                    candidates.push_back(cell);
-                }
-            }
+    int categoryCount = ruleset->getCategoryCount();
+    uint64_t present = 0;
+    for (int w = 0; w < wordsPerDomain; ++w) {
+        uint64_t bits = domainWord(cellIndex, w);
+        if (!bits) continue;
+        for (int c = 0; c < categoryCount; ++c) {
+            if (!(present & (uint64_t(1) << c)) && (bits & ruleset->getCategoryMask(c)[w])) present |= uint64_t(1) << c;
         }
     }
+    if ((present & (present - 1)) == 0) return nullptr;
 
-    if (candidates.empty()) {
-        return nullptr; // ûпѡĵԪ
+    uint64_t allowed = 0;
+    for (uint64_t bits = present; bits; bits &= bits - 1) {
+        allowed |= ruleset->getCategorySupport(lowestBitIndex(bits), dir);
+    }
+    uint64_t* support = ctx.supportMask.data();
+    std::fill(support, support + wordsPerDomain, 0);
+    for (uint64_t bits = allowed; bits; bits &= bits - 1) {
+        const uint64_t* members = ruleset->getCategoryMask(lowestBitIndex(bits));
+        for (int w = 0; w < wordsPerDomain; ++w) support[w] |= members[w];
     }
-    // Ӻѡѡһ
-    std::uniform_int_distribution<size_t> distrib(0, candidates.size() - 1);
-    return candidates[distrib(gen)];
+    return support;
 }
 
 /**
- * @brief ȨغȫƣΪԪѡһģ̮
- * @param cell Ҫ̮ĵԪ
- * @param chosenModuleId [out] ڴ洢ѡģIDá
- * @return ɹѡһģ飬 true򷵻 false
+ * @brief 估算一次生成所需的内存池大小。
+ * 轨迹的预留容量按历史峰值增长，因此同一生成器重复生成时内存池不会再向系统堆扩容。
+ * @return 需要的字节数（包含对齐余量）。
  */
-bool WFCGenerator::collapseCell(Cell* cell, std::string& chosenModuleId) {
-    if (cell->possibleModules.empty()) {
-        return false;
+size_t WFCGenerator::estimateArenaBytes() const {
+    size_t cells = static_cast<size_t>(width) * height;
+    size_t bytes = 0;
+    bytes += options.headless ? 0 : cells * sizeof(Cell);
+    size_t chunkCount = (cells >> domainChunkShift) + 1;
+    bytes += chunkCount * (sizeof(uint64_t*) + sizeof(int*)); // domainChunks, sizeChunks
+    bytes += domainChunkReserve * domainChunkBytes();       // 已建立的位集块
+    bytes += interning ? cells * sizeof(DomainInterner::Handle) : 0; // domainHandles
+    bytes += cells * sizeof(int) * 9;                       // propagationStack, candidateCells, component*, entropy*
+    bytes += cells * sizeof(char);                          // inPropagationStack
+    bytes += cells * sizeof(StateSnapshot);                 // decisions
+    bytes += trailReserve * sizeof(TrailEntry);             // trail
+    bytes += moduleCount * (sizeof(int) * 3 + sizeof(double)); // moduleCounts, moduleLimits, candidates
+    bytes += memberCount * sizeof(int) * 2;                 // memberCounts, memberLimits
+    bytes += wordsPerDomain * sizeof(uint64_t);             // supportMask
+    bytes += options.batchCollapse ? options.batchSize * sizeof(int) : 0; // batchCells
+    if (options.learnNogoods) {
+        bytes += nogoodReserve * (options.maxNogoodSize + 1) * sizeof(NogoodLiteral); // nogoodLiterals, unitNogoods
+        bytes += nogoodReserve * sizeof(int) * 3;           // nogoodStarts, watchNext
+        bytes += cells * (sizeof(int) + sizeof(NogoodLiteral)); // watchHeads, conflictLiterals
+        bytes += reasonReserve * sizeof(int);               // reasonPool
     }
+    return bytes + 32 * alignof(std::max_align_t) + 1024;
+}
 
-    std::vector<std::string> weightedModules; // 洢ģID
-    std::vector<double> weights;              // 洢ӦȨ
+/**
+ * @brief 是否使用合并存储保存可能模块集合。
+ * 合并表和记忆表在求解过程中不断增长，不能被并行的子问题同时修改，因此并行分解时不使用。
+ * @param options 求解策略。
+ */
+bool WFCGenerator::useInterning(const WFCOptions& options) const {
+    return options.internDomains && !(options.decomposeComponents && options.parallelComponents);
+}
 
-    // пܵģ飬ɸѡȫƵģ
-    for (const auto& moduleId : cell->possibleModules) {
-        const Module* modulePtr = nullptr;
-        for (const auto& m : allModules) {
-            if (m.id == moduleId) {
-                modulePtr = &m;
-                break;
-            }
-        }
+/**
+ * @brief 根据模块数量和并行策略选择紧凑位集的位数。
+ * 模块不超过 32 个时，每个单元格的位集只占一个字的一部分，按 2 的幂位数紧凑存放。
+ * 紧凑存储时相邻单元格共用同一个字，并行求解的子问题会同时写入，因此并行分解时使用宽存储。
+ * @param options 求解策略。
+ * @return 每格的位数，0 表示宽存储。
+ */
+int WFCGenerator::selectDomainBits(const WFCOptions& options) const {
+    if (moduleCount > 32 || useInterning(options) || (options.decomposeComponents && options.parallelComponents)) {
+        return 0;
+    }
+    int bits = 2;
+    while (bits < moduleCount) bits *= 2;
+    return bits;
+}
 
-        if (modulePtr) {
-            // ģȫƣҵǰѴﵽޣ
-            if (globalModuleLimits.count(moduleId) && globalModuleCounts[moduleId] >= globalModuleLimits[moduleId]) {
-                continue;
-            }
-            weightedModules.push_back(moduleId);
-            weights.push_back(modulePtr->weight);
+/**
+ * @brief 初始化运行状态。
+ * 上一次生成的状态随内存池一次性释放，然后在同一块缓冲区中重新分配。
+ */
+void WFCGenerator::initializeGrid() {
+    size_t cellCount = static_cast<size_t>(width) * height;
+    trailReserve = std::max(trailReserve, cellCount * 2);
+    if (options.learnNogoods) {
+        // nogood 数量有上限，初始按单元格数预留，之后按历史峰值增长
+        size_t nogoodLimit = static_cast<size_t>(std::max(options.maxNogoods, 0)) + 2;
+        nogoodReserve = std::min(std::max(nogoodReserve, cellCount / 8 + 16), nogoodLimit);
+        reasonReserve = std::max(reasonReserve, cellCount);
+    }
+    domainBits = selectDomainBits(options);
+    interning = useInterning(options);
+    if (interning && !interner) {
+        interner = std::make_unique<DomainInterner>(*ruleset);
+    }
+    domainShift = 0;
+    while ((1 << domainShift) < domainBits) domainShift++;
+    domainMask = domainBits ? (uint64_t(1) << domainBits) - 1 : 0;
+
+    state.reset();
+    size_t required = estimateArenaBytes();
+    if (!arena || arenaBuffer.size() < required) {
+        arena.reset();
+        arenaBuffer.resize(required);
+        arena = std::make_unique<std::pmr::monotonic_buffer_resource>(arenaBuffer.data(), arenaBuffer.size());
+    }
+    else {
+        arena->release();
+    }
+    state.emplace(arena.get());
+    SolverState& s = *state;
+
+    // 单元格按存储索引的顺序排列；无界面模式下不创建 Cell 对象
+    if (!options.headless) {
+        s.cells.reserve(cellCount);
+        for (size_t index = 0; index < cellCount; ++index) {
+            int x, y;
+            layout.coordinatesOf(static_cast<int>(index), x, y);
+            s.cells.emplace_back(x, y);
+            grid[y][x] = &s.cells.back();
         }
     }
+    else {
+        for (auto& row : grid) std::fill(row.begin(), row.end(), nullptr);
+    }
+    results.configure(cellCount, std::max(moduleCount, memberCount)); // 超出容量时 generate() 直接失败
+    resultsExpanded = false;
 
-    if (weightedModules.empty()) {
-        return false; // ûпõģѡ
+    // 所有单元格初始时包含全部模块：位集块全部留空，第一次修改时才建立
+    fullCellDomain = domainBits ? (uint64_t(1) << moduleCount) - 1 : 0;
+    s.fullDomain.assign(wordsPerDomain, ~uint64_t(0));
+    if (moduleCount % 64 != 0) {
+        s.fullDomain[wordsPerDomain - 1] = (uint64_t(1) << (moduleCount % 64)) - 1;
+    }
+    size_t chunkCount = (cellCount + domainChunkMask) >> domainChunkShift;
+    s.domainChunks.assign(chunkCount, nullptr);
+    s.sizeChunks.assign(chunkCount, nullptr);
+    s.materializedChunks = 0;
+    if (interning) {
+        s.domainHandles.assign(cellCount, DomainInterner::FullDomain);
     }
 
-    // ʹɢֲȨѡһģ
-    std::discrete_distribution<> distrib(weights.begin(), weights.end());
-    chosenModuleId = weightedModules[distrib(gen)];
+    s.moduleLimits.assign(moduleCount, -1);
+    s.memberCounts.assign(memberCount, 0);
+    s.memberLimits.assign(memberCount, -1);
+    s.inPropagationStack.assign(cellCount, 0);
+    s.componentLabels.assign(cellCount, -1);
+    s.componentCells.reserve(cellCount);
+    s.componentStarts.reserve(cellCount + 1);
+    s.entropyCells.assign(cellCount, 0);
+    s.entropySlots.assign(cellCount, 0);
+    s.entropyKeys.assign(cellCount, 0);
+    s.entropyStarts.reserve(moduleCount + 2);
+    if (options.learnNogoods) {
+        s.nogoodLiterals.reserve(nogoodReserve * options.maxNogoodSize);
+        s.nogoodStarts.reserve(nogoodReserve + 1);
+        s.unitNogoods.reserve(nogoodReserve);
+        s.watchHeads.reserve(cellCount);
+        s.watchNext.reserve(nogoodReserve * 2);
+        s.reasonPool.reserve(reasonReserve);
+        s.conflictLiterals.reserve(cellCount);
+    }
 
-    return true;
+    prepareContext(s.root, cellCount, trailReserve);
+    s.root.rng = &gen;
+    stateReady = true;
 }
 
 /**
- * @brief һ㿪ʼ⴫Լ
- * һԪ״̬ıʱ˺ھӵĿģб
- * @param startX ʼԪXꡣ
- * @param startY ʼԪYꡣ
- * @return ûеìܣûеԪĿģΪգ true
+ * @brief 一个位集块占用的 64 位字数。
  */
-bool WFCGenerator::propagate(int startX, int startY) {
-    std::vector<std::pair<int, int>> stack; // ʹջҪĵԪ
-    stack.push_back({ startX, startY });
+size_t WFCGenerator::domainChunkWords() const {
+    size_t chunkCells = size_t(1) << domainChunkShift;
+    return domainBits ? ((chunkCells << domainShift) + 63) / 64 : chunkCells * wordsPerDomain;
+}
 
-    while (!stack.empty()) {
-        std::pair<int, int> current = stack.back();
-        stack.pop_back();
-        int x = current.first;
-        int y = current.second;
+/**
+ * @brief 一个位集块（位集和熵）占用的字节数，包含对齐余量。
+ */
+size_t WFCGenerator::domainChunkBytes() const {
+    return domainChunkWords() * sizeof(uint64_t) + (size_t(1) << domainChunkShift) * sizeof(int) + 2 * alignof(std::max_align_t);
+}
 
-        Cell* currentCell = grid[y][x];
-        // ȡǰԪĿģ鼯
-        std::set<std::string> possibleModulesInCurrentCell = currentCell->isCollapsed ?
-            std::set<std::string>{currentCell->chosenModuleId} :
-            currentCell->possibleModules;
+/**
+ * @brief 为一块单元格分配并填充完整的可能模块位集。
+ * 在第一次从块中移除模块时调用；块中所有单元格的熵都初始化为模块数量。
+ * @param chunkIndex 块索引。
+ * @return 块的位集存储。
+ */
+uint64_t* WFCGenerator::materializeDomainChunk(int chunkIndex) {
+    SolverState& s = *state;
+    std::pmr::memory_resource* resource = s.domainChunks.get_allocator().resource();
+    size_t words = domainChunkWords();
+    size_t chunkCells = size_t(1) << domainChunkShift;
 
-        // ĸƫ
-        int dx[] = { 0, 0, -1, 1 }; // TOP, BOTTOM, LEFT, RIGHT
-        int dy[] = { -1, 1, 0, 0 };
+    uint64_t* chunk = static_cast<uint64_t*>(resource->allocate(words * sizeof(uint64_t), alignof(uint64_t)));
+    if (domainBits) {
+        // 紧凑存储：把一个单元格的完整位集重复铺满整个字
+        uint64_t pattern = 0;
+        for (int offset = 0; offset < 64; offset += domainBits) pattern |= fullCellDomain << offset;
+        std::fill(chunk, chunk + words, pattern);
+    }
+    else {
+        for (size_t c = 0; c < chunkCells; ++c) {
+            std::copy(s.fullDomain.begin(), s.fullDomain.end(), chunk + c * wordsPerDomain);
+        }
+    }
+    int* sizes = static_cast<int*>(resource->allocate(chunkCells * sizeof(int), alignof(int)));
+    std::fill(sizes, sizes + chunkCells, moduleCount);
 
-        for (int i = 0; i < 4; ++i) {
-            int nx = x + dx[i];
-            int ny = y + dy[i];
-            Direction dir = static_cast<Direction>(i);
+    s.domainChunks[chunkIndex] = chunk;
+    s.sizeChunks[chunkIndex] = sizes;
+    s.materializedChunks++;
+    return chunk;
+}
 
-            if (nx >= 0 && nx < width && ny >= 0 && ny < height) {
-                Cell* neighborCell = grid[ny][nx];
-                if (neighborCell->isCollapsed) continue;
+/**
+ * @brief 建立所有尚未建立的位集块。
+ * 位集块从单调内存池中分配，内存池不是线程安全的，因此在并行求解子问题之前统一建立。
+ */
+void WFCGenerator::materializeAllDomainChunks() {
+    SolverState& s = *state;
+    for (size_t chunk = 0; chunk < s.domainChunks.size(); ++chunk) {
+        if (!s.domainChunks[chunk]) materializeDomainChunk(static_cast<int>(chunk));
+    }
+}
 
-                std::set<std::string> modulesToRemove;
-                // ھӵÿģ
-                for (const auto& possibleNeighborModuleId : neighborCell->possibleModules) {
-                    const Module* possibleNeighborModule = nullptr;
-                    for (const auto& m : allModules) if (m.id == possibleNeighborModuleId) possibleNeighborModule = &m;
+/**
+ * @brief 为搜索上下文预留容量并清空计数。
+ * @param ctx 搜索上下文。
+ * @param cellCount 搜索范围内的单元格数量。
+ * @param trailCapacity 轨迹的预留容量。
+ */
+void WFCGenerator::prepareContext(SearchContext& ctx, size_t cellCount, size_t trailCapacity) {
+    ctx.trail.reserve(trailCapacity);
+    ctx.decisions.reserve(cellCount);
+    ctx.propagationStack.reserve(cellCount);
+    ctx.candidateCells.reserve(cellCount);
+    ctx.candidateModules.reserve(moduleCount);
+    ctx.candidateWeights.reserve(moduleCount);
+    if (options.batchCollapse) ctx.batchCells.reserve(options.batchSize);
+    ctx.supportMask.assign(wordsPerDomain, 0);
+    ctx.moduleCounts.assign(moduleCount, 0);
+    ctx.collapsedCount = 0;
+    ctx.emptyCells = 0;
+    ctx.lastCollapsed = -1;
+    ctx.orderCursor = 0;
+}
 
-                    if (!possibleNeighborModule) continue;
+/**
+ * @brief 把按ID设置的全局数量上限解析为按模块索引的上限。
+ * 上限可能在 reset() 之后才设置，因此在每次生成开始时解析。
+ */
+void WFCGenerator::applyGlobalLimits() {
+    SolverState& s = *state;
+    std::fill(s.moduleLimits.begin(), s.moduleLimits.end(), -1);
+    if (!ruleset->isCompressed()) {
+        for (const auto& limit : globalModuleLimits) {
+            int m = ruleset->findModule(limit.first);
+            if (m >= 0) s.moduleLimits[m] = limit.second;
+        }
+        return;
+    }
 
-                    // 鵱ǰԪǷκģ֧ھģ
-                    bool isSupported = false;
-                    for (const auto& possibleCurrentModuleId : possibleModulesInCurrentCell) {
-                        const Module* possibleCurrentModule = nullptr;
-                        for (const auto& m : allModules) if (m.id == possibleCurrentModuleId) possibleCurrentModule = &m;
+    // 压缩规则集：上限针对具体模块，等价类的上限是成员上限之和（任一成员不限时等价类也不限）
+    const Ruleset& original = *ruleset->getParent();
+    std::fill(s.memberLimits.begin(), s.memberLimits.end(), -1);
+    for (const auto& limit : globalModuleLimits) {
+        int m = original.findModule(limit.first);
+        if (m >= 0) s.memberLimits[m] = limit.second;
+    }
+    for (int c = 0; c < moduleCount; ++c) {
+        int classLimit = 0;
+        for (int member : ruleset->getClassMembers(c)) {
+            if (s.memberLimits[member] < 0) {
+                classLimit = -1;
+                break;
+            }
+            classLimit += s.memberLimits[member];
+        }
+        s.moduleLimits[c] = classLimit;
+    }
+}
 
-                        if (possibleCurrentModule && possibleCurrentModule->isCompatible(dir, *possibleNeighborModule)) {
-                            isSupported = true;
-                            break;
-                        }
-                    }
+/**
+ * @brief 把坍缩为等价类的单元格展开为具体的成员模块。
+ * 每个单元格在其等价类中按权重抽样，跳过已达到全局上限的成员。
+ * 等价类的计数不超过成员上限之和，因此总能找到可用的成员。
+ */
+void WFCGenerator::expandEquivalenceClasses() {
+    SolverState& s = *state;
+    const Ruleset& original = *ruleset->getParent();
+    std::fill(s.memberCounts.begin(), s.memberCounts.end(), 0);
 
-                    // ûκģ֧֣򽫸ھģΪƳ
-                    if (!isSupported) {
-                        modulesToRemove.insert(possibleNeighborModuleId);
-                    }
-                }
+    int cellCount = width * height;
+    for (int c = 0; c < cellCount; ++c) {
+        int classIndex = results.get(c);
+        if (classIndex < 0) continue;
+        const std::vector<int>& members = ruleset->getClassMembers(classIndex);
 
-                // ҪƳģ
-                if (!modulesToRemove.empty()) {
-                    bool changed = false;
-                    for (const auto& moduleId : modulesToRemove) {
-                        if (neighborCell->removePossibleModule(moduleId)) {
-                            changed = true;
-                        }
-                    }
-                    // ھӵ״̬˱仯ջԱһ
-                    if (changed) {
-                        if (neighborCell->possibleModules.empty()) {
-                            return false; // ìܣʧ
-                        }
-                        stack.push_back({ nx, ny });
-                    }
-                }
-            }
+        double totalWeight = 0.0;
+        for (int member : members) {
+            if (s.memberLimits[member] >= 0 && s.memberCounts[member] >= s.memberLimits[member]) continue;
+            totalWeight += original.getWeight(member);
+        }
+        std::uniform_real_distribution<double> distrib(0.0, totalWeight);
+        double r = distrib(gen);
+        int chosen = -1;
+        for (int member : members) {
+            if (s.memberLimits[member] >= 0 && s.memberCounts[member] >= s.memberLimits[member]) continue;
+            chosen = member;
+            r -= original.getWeight(member);
+            if (r < 0.0) break;
         }
+        results.set(c, chosen);
+        s.memberCounts[chosen]++;
     }
-    return true; // ɹ
+    resultsExpanded = true;
 }
 
 /**
- * @brief ̮һԪ֮ǰ浱ǰ״̬ա
- * @param cellToCollapse ̮ĵԪ
- * @param chosenModuleId ΪõԪѡģID
+ * @brief 用长条精确采样器生成整张地图。
+ * 采样结果写入紧凑结果并累计计数，不经过搜索状态。压缩规则集保留等价类索引，
+ * 之后与搜索的结果一样由 expandEquivalenceClasses() 展开，单个成员的全局上限在那里生效。
+ * @param success [out] 是否得到了合法地图；规则集在该尺寸下无解时为 false。
+ * @return 行状态数量超出采样器上限、需要退回普通搜索时返回 false。
  */
-void WFCGenerator::saveState(Cell* cellToCollapse, const std::string& chosenModuleId) {
-    std::map<std::pair<int, int>, std::set<std::string>> currentGridState;
-    // ¼ÿԪĿģ
-    for (int i = 0; i < height; ++i) {
-        for (int j = 0; j < width; ++j) {
-            currentGridState[{j, i}] = grid[i][j]->possibleModules;
+bool WFCGenerator::sampleStrip(bool& success) {
+    if (!stripSampler) {
+        stripSampler = std::make_unique<WFCStripSampler>(width, height, ruleset);
+    }
+    if (!stripSampler->build() && !stripSampler->hasNoValidRow()) {
+        std::cout << "Strip sampler unavailable, falling back to search." << std::endl;
+        return false;
+    }
+
+    std::vector<int> modules;
+    success = stripSampler->sample(gen(), modules, false);
+    if (!success) return true;
+
+    SearchContext& ctx = state->root;
+    std::fill(ctx.moduleCounts.begin(), ctx.moduleCounts.end(), 0);
+    for (int y = 0; y < height; ++y) {
+        for (int x = 0; x < width; ++x) {
+            int module = modules[static_cast<size_t>(y) * width + x];
+            results.set(layout.indexOf(x, y), module);
+            ctx.moduleCounts[module]++;
         }
     }
-    // ѹջ
-    stateStack.push({ cellToCollapse->x, cellToCollapse->y,
-                     cellToCollapse->possibleModules,
-                     chosenModuleId,
-                     currentGridState,
-                     globalModuleCounts });
+    return true;
 }
 
 /**
- * @brief ִлݡ
- * ìʱָһ״̬ʧܵѡƳѡ
- * @return ݳɹҴûµìܣ true
+ * @brief 根据紧凑结果建立 Cell 视图。
+ * 求解过程中只维护紧凑结果，Cell 对象在生成结束后统一填写。
  */
-bool WFCGenerator::backtrack() {
-    if (stateStack.empty()) {
-        return false; // ûпɻݵ״̬
+void WFCGenerator::materializeCells() {
+    SolverState& s = *state;
+    const Ruleset& alphabet = getResultRuleset();
+    for (size_t c = 0; c < s.cells.size(); ++c) {
+        int module = results.get(c);
+        s.cells[c].isCollapsed = module >= 0;
+        s.cells[c].module = module >= 0 ? &alphabet.getModule(module) : nullptr;
     }
+}
 
-    StateSnapshot lastState = stateStack.top();
-    stateStack.pop();
+/**
+ * @brief 是否有任何模块受全局上限约束。
+ * 全局上限把所有单元格关联在一起，此时不能把网格分解为独立子问题。
+ */
+bool WFCGenerator::hasGlobalLimits() const {
+    for (int limit : state->moduleLimits) {
+        if (limit >= 0) return true;
+    }
+    return false;
+}
 
-    // ָ״̬
-    for (int i = 0; i < height; ++i) {
-        for (int j = 0; j < width; ++j) {
-            grid[i][j]->isCollapsed = false;
-            grid[i][j]->chosenModuleId = "";
-            if (lastState.gridStateSnapshot.count({ j, i })) {
-                grid[i][j]->possibleModules = lastState.gridStateSnapshot.at({ j, i });
+/**
+ * @brief 用位平面对初始网格做整体弧相容处理。
+ * 数量上限为 0 的模块在所有单元格中被批量禁用，随后删除在任一方向上得不到邻居支持的模块。
+ * 处理结果直接写入初始的可能模块集合，不记录到回溯轨迹中。
+ * @return 如果网格仍可能有解则返回 true，否则返回 false。
+ */
+bool WFCGenerator::applyInitialArcConsistency() {
+    SolverState& s = *state;
+    if (!planeGrid) {
+        planeGrid = std::make_unique<BitPlaneGrid>(width, height, ruleset);
+    }
+    else {
+        planeGrid->reset();
+    }
+    BitPlaneGrid& planes = *planeGrid;
+    for (int m = 0; m < moduleCount; ++m) {
+        if (s.moduleLimits[m] == 0) planes.banModule(m);
+    }
+    if (!planes.enforceArcConsistency()) {
+        return false;
+    }
+
+    // 只遍历被删除的位，把结果转置回按单元格存储的可能模块集合
+    int wordsPerRow = planes.getWordsPerRow();
+    for (int m = 0; m < moduleCount; ++m) {
+        const uint64_t* plane = planes.getPlane(m);
+        for (int y = 0; y < height; ++y) {
+            for (int w = 0; w < wordsPerRow; ++w) {
+                int rowBits = std::min(64, width - w * 64);
+                uint64_t valid = rowBits == 64 ? ~uint64_t(0) : (uint64_t(1) << rowBits) - 1;
+                for (uint64_t removed = valid & ~plane[static_cast<size_t>(y) * wordsPerRow + w]; removed; removed &= removed - 1) {
+                    int cellIndex = layout.indexOf(w * 64 + lowestBitIndex(removed), y);
+                    removeDomainBit(cellIndex, m);
+                }
             }
         }
     }
+    return true;
+}
+
+/**
+ * @brief 从单元格的可能模块中移除一个模块，并把移除和原因记录到轨迹中。
+ * @param ctx 搜索上下文。
+ * @param cellIndex 单元格索引。
+ * @param module 要移除的模块索引。
+ * @param reason 移除原因，编码见 TrailEntry::reason。
+ */
+void WFCGenerator::removeModule(SearchContext& ctx, int cellIndex, int module, int reason) {
+    if (hasDomainBit(cellIndex, module)) {
+        removeDomainBit(cellIndex, module);
+        ctx.trail.push_back({ cellIndex, module, false, reason });
+        updateEntropyBucket(ctx, cellIndex);
+        if (domainSize(cellIndex) == 0 && ctx.emptyCells++ == 0) ctx.conflictCell = cellIndex;
+    }
+}
+
+/**
+ * @brief 按当前熵建立根搜索的熵分段（计数排序）。
+ * 每个熵值的单元格在 entropyCells 中连续排列，因此最低熵的并列单元格就是最低的非空段，
+ * 选择单元格时不必扫描网格。
+ */
+void WFCGenerator::buildEntropyBuckets() {
+    SolverState& s = *state;
+    int cellCount = width * height;
+    s.entropyStarts.assign(moduleCount + 2, 0);
+    for (int c = 0; c < cellCount; ++c) {
+        int key = results.isSet(c) ? 0 : domainSize(c);
+        s.entropyKeys[c] = key;
+        s.entropyStarts[key + 1]++;
+    }
+    for (int k = 1; k <= moduleCount + 1; ++k) s.entropyStarts[k] += s.entropyStarts[k - 1];
+    for (int c = 0; c < cellCount; ++c) {
+        int slot = s.entropyStarts[s.entropyKeys[c]]++;
+        s.entropyCells[slot] = c;
+        s.entropySlots[c] = slot;
+    }
+    // 放置后每个起点都移到了段尾，整体右移一位还原
+    for (int k = moduleCount + 1; k > 0; --k) s.entropyStarts[k] = s.entropyStarts[k - 1];
+    s.entropyStarts[0] = 0;
+}
+
+/**
+ * @brief 根搜索中单元格的熵变化后，把它逐段移到对应的段。
+ * 每次只与相邻段的边界单元格交换并移动边界，一个模块的增减对应 O(1) 的工作。
+ * 子问题不维护熵分段：失败时修改全部撤销，成功时根搜索随即结束。
+ * @param ctx 搜索上下文。
+ * @param cellIndex 单元格索引。
+ */
+void WFCGenerator::updateEntropyBucket(SearchContext& ctx, int cellIndex) {
+    if (&ctx != &state->root) return;
+    SolverState& s = *state;
+    int key = results.isSet(cellIndex) ? 0 : domainSize(cellIndex);
+    int& current = s.entropyKeys[cellIndex];
+    auto moveTo = [&](int slot) {
+        int other = s.entropyCells[slot];
+        int from = s.entropySlots[cellIndex];
+        s.entropyCells[from] = other;
+        s.entropySlots[other] = from;
+        s.entropyCells[slot] = cellIndex;
+        s.entropySlots[cellIndex] = slot;
+    };
+    while (current > key) {
+        // 换到本段开头，再把段起点后移：落入下一个较低段的末尾
+        moveTo(s.entropyStarts[current]);
+        s.entropyStarts[current]++;
+        current--;
+    }
+    while (current < key) {
+        // 换到本段末尾，再把上一段的起点前移：落入较高段的开头
+        moveTo(s.entropyStarts[current + 1] - 1);
+        s.entropyStarts[current + 1]--;
+        current++;
+    }
+}
 
-    // ָȫģ
-    globalModuleCounts = lastState.globalModuleCountsSnapshot;
+/**
+ * @brief 把轨迹逆序撤销到指定长度，恢复期间被移除的模块和被坍缩的单元格。
+ * 坍缩计数、矛盾计数、熵分段和选择顺序的游标随每条记录一起撤销。
+ * @param ctx 搜索上下文。
+ * @param mark 目标轨迹长度。
+ */
+void WFCGenerator::undoTrail(SearchContext& ctx, size_t mark) {
+    while (ctx.trail.size() > mark) {
+        TrailEntry entry = ctx.trail.back();
+        ctx.trail.pop_back();
+        if (entry.isCollapse) {
+            results.clear(entry.cellIndex);
+            ctx.moduleCounts[entry.moduleIndex]--;
+            ctx.collapsedCount--;
+            updateEntropyBucket(ctx, entry.cellIndex);
+            if (usesSelectionOrder()) ctx.orderCursor = std::min(ctx.orderCursor, orderPosition(ctx, entry.cellIndex));
+        }
+        else {
+            if (domainSize(entry.cellIndex) == 0) ctx.emptyCells--;
+            restoreDomainBit(entry.cellIndex, entry.moduleIndex);
+            updateEntropyBucket(ctx, entry.cellIndex);
+            // 原因池与轨迹同步增长，撤销时一并截断
+            if (entry.reason <= -2 && isLearning(ctx)) state->reasonPool.resize(-2 - entry.reason);
+        }
+    }
+}
 
-    // ӵʧܵĵԪĿģУƳǸʧܵѡ
-    Cell* failedCell = grid[lastState.cellY][lastState.cellX];
-    failedCell->removePossibleModule(lastState.attemptedModuleId);
+/**
+ * @brief 按选择策略返回下一个坍缩的单元格。
+ * @param ctx 搜索上下文。
+ * @return 单元格索引，如果所有单元格都已坍缩，则返回 -1。
+ */
+int WFCGenerator::selectCell(SearchContext& ctx) {
+    switch (options.cellSelection) {
+    case CellSelection::DomOverWDeg:
+        return getDomWDegCell(ctx);
+    case CellSelection::NearestToLast:
+        return getNearestCell(ctx);
+    case CellSelection::Scanline:
+    case CellSelection::Spiral:
+        return getOrderedCell(ctx);
+    case CellSelection::BeliefMarginal:
+        return &ctx == &state->root ? getBeliefCell(ctx) : getLowestEntropyCell(ctx);
+    default:
+        return getLowestEntropyCell(ctx);
+    }
+}
 
-    // ƳõԪûԣҪһ
-    if (failedCell->possibleModules.empty()) {
-        return backtrack();
+/**
+ * @brief 查找并返回搜索范围内熵最低的未坍缩单元格。
+ * 如果有多个熵最低的单元格，则从中随机选择一个（EntropyNearest 选择离上一次坍缩最近的）。
+ * 根搜索直接取最低的非空熵分段；子问题扫描自己的范围。
+ * @param ctx 搜索上下文。
+ * @return 熵最低的单元格索引，如果所有单元格都已坍缩，则返回 -1。
+ */
+int WFCGenerator::getLowestEntropyCell(SearchContext& ctx) {
+    SolverState& s = *state;
+    if (&ctx == &s.root) {
+        for (int key = 1; key <= moduleCount; ++key) {
+            int first = s.entropyStarts[key];
+            int last = s.entropyStarts[key + 1];
+            if (first == last) continue;
+            if (options.cellSelection == CellSelection::EntropyNearest && ctx.lastCollapsed >= 0) {
+                int nearest = findNearestCell(ctx, key);
+                if (nearest >= 0) return nearest;
+            }
+            std::uniform_int_distribution<int> distrib(first, last - 1);
+            return s.entropyCells[distrib(*ctx.rng)];
+        }
+        return -1;
     }
 
-    std::cout << "Backtracking from cell (" << failedCell->x << ", " << failedCell->y
-        << "). Removed module " << lastState.attemptedModuleId << " from possibilities." << std::endl;
+    int minEntropy = moduleCount + 1;
+    ctx.candidateCells.clear(); // 存储所有熵最低的候选单元格
+    for (int c : ctx.region) {
+        if (results.isSet(c)) continue;
+        int currentEntropy = domainSize(c);
+        if (currentEntropy == 0) continue;
+        if (currentEntropy < minEntropy) {
+            minEntropy = currentEntropy;
+            ctx.candidateCells.clear();
+            ctx.candidateCells.push_back(c);
+        }
+        else if (currentEntropy == minEntropy) {
+            ctx.candidateCells.push_back(c);
+        }
+    }
 
-    // ʧܵĵԪʼ´Լ
-    return propagate(failedCell->x, failedCell->y);
+    if (ctx.candidateCells.empty()) {
+        return -1; // 没有可选择的单元格
+    }
+    return pickCandidate(ctx);
 }
 
 /**
- * @brief ѭ
- * ѡ͵ĵԪ̮ʹֱеԪ̮޷ҵ⡣
- * @return ɹ񣬷 true
+ * @brief 在上一次坍缩周围的窗口内做几轮循环信念传播，返回边缘分布最集中的单元格。
+ * 单元格 i 发往邻居 j 的消息为 μ(x_j) ∝ Σ w(x_i) · Π(其余方向传入 i 的消息)(x_i) · [x_j 可以放在 x_i 的该方向上]，
+ * 只在双方的可能模块上计算并归一化；窗口外的邻居和已坍缩的邻居不发消息，它们的约束已体现在可能模块集合中。
+ * 消息按单元格顺序原地更新。边缘分布 b(x) ∝ w(x) · Π(传入消息)(x)；边缘分布全为 0 的单元格
+ * 说明窗口内已无解，优先选择以便尽快回溯。被选单元格的边缘分布保存在 beliefMarginal 中供 collapseCell 抽样。
+ * @param ctx 根搜索上下文。
+ * @return 单元格索引，如果所有单元格都已坍缩，则返回 -1。
  */
-bool WFCGenerator::generate() {
-    int collapsedCount = 0;
-    int totalCells = width * height;
+int WFCGenerator::getBeliefCell(SearchContext& ctx) {
+    beliefCell = -1;
+    if (ctx.lastCollapsed < 0) {
+        return getLowestEntropyCell(ctx);
+    }
 
-    while (collapsedCount < totalCells)
-    {
-        // 1. ѡ͵ĵԪ
-        Cell* targetCell = getLowestEntropyCell();
-        if (!targetCell) {
-            if (collapsedCount == totalCells) break; // еԪ̮ɹ
-            std::cout << "Error: No valid cell to collapse, but not all cells are collapsed." << std::endl;
-            if (!backtrack()) { // ޷ѡԪ񣬳Ի
-                std::cout << "Backtrack failed. No solution found." << std::endl;
-                return false;
+    // 1. 收集窗口内的未坍缩单元格
+    int centerX, centerY;
+    layout.coordinatesOf(ctx.lastCollapsed, centerX, centerY);
+    int radius = std::max(1, options.beliefWindow);
+    int side = 2 * radius + 1;
+    beliefSlots.assign(static_cast<size_t>(side) * side, -1);
+    beliefCells.clear();
+    for (int y = std::max(0, centerY - radius); y <= std::min(height - 1, centerY + radius); ++y) {
+        for (int x = std::max(0, centerX - radius); x <= std::min(width - 1, centerX + radius); ++x) {
+            int c = layout.indexOf(x, y);
+            if (results.isSet(c)) continue;
+            beliefSlots[static_cast<size_t>(y - centerY + radius) * side + x - centerX + radius] = static_cast<int>(beliefCells.size());
+            beliefCells.push_back(c);
+        }
+    }
+    if (beliefCells.empty()) {
+        return getLowestEntropyCell(ctx);
+    }
+
+    const int stepX[COUNT] = { 0, 0, -1, 1 };
+    const int stepY[COUNT] = { -1, 1, 0, 0 };
+    const int opposite[COUNT] = { BOTTOM, TOP, RIGHT, LEFT };
+    auto slotAt = [&](int x, int y) {
+        if (x < centerX - radius || x > centerX + radius || y < centerY - radius || y > centerY + radius) return -1;
+        return beliefSlots[static_cast<size_t>(y - centerY + radius) * side + x - centerX + radius];
+    };
+    auto message = [&](int slot, int dir) {
+        return &beliefMessages[(static_cast<size_t>(slot) * COUNT + dir) * moduleCount];
+    };
+
+    // 2. 循环信念传播；beliefMarginal 在迭代中用作发出消息的暂存
+    beliefMessages.assign(beliefCells.size() * COUNT * moduleCount, 1.0);
+    beliefMarginal.assign(moduleCount, 0.0);
+    for (int iteration = 0; iteration < options.beliefIterations; ++iteration) {
+        for (size_t i = 0; i < beliefCells.size(); ++i) {
+            int cell = beliefCells[i];
+            int x, y;
+            layout.coordinatesOf(cell, x, y);
+            for (int dir = 0; dir < COUNT; ++dir) {
+                int j = slotAt(x + stepX[dir], y + stepY[dir]);
+                if (j < 0) continue;
+                std::fill(beliefMarginal.begin(), beliefMarginal.end(), 0.0);
+                for (int w = 0; w < wordsPerDomain; ++w) {
+                    for (uint64_t bits = domainWord(cell, w); bits; bits &= bits - 1) {
+                        int m = w * 64 + lowestBitIndex(bits);
+                        double p = ruleset->getWeight(m);
+                        for (int other = 0; other < COUNT && p > 0.0; ++other) {
+                            if (other != dir) p *= message(static_cast<int>(i), other)[m];
+                        }
+                        if (p <= 0.0) continue;
+                        ruleset->forEachCompatible(m, dir, [&](int n) { beliefMarginal[n] += p; });
+                    }
+                }
+
+                int neighbor = beliefCells[j];
+                double total = 0.0;
+                for (int w = 0; w < wordsPerDomain; ++w) {
+                    for (uint64_t bits = domainWord(neighbor, w); bits; bits &= bits - 1) total += beliefMarginal[w * 64 + lowestBitIndex(bits)];
+                }
+                double* incoming = message(j, opposite[dir]);
+                for (int w = 0; w < wordsPerDomain; ++w) {
+                    for (uint64_t bits = domainWord(neighbor, w); bits; bits &= bits - 1) {
+                        int n = w * 64 + lowestBitIndex(bits);
+                        incoming[n] = total > 0.0 ? beliefMarginal[n] / total : 0.0;
+                    }
+                }
             }
-            continue;
         }
+    }
 
-        // ѡеĵԪѾûпģ飬˵ì
-        if (targetCell->possibleModules.empty()) {
-            std::cout << "Contradiction found at (" << targetCell->x << ", " << targetCell->y << "). Attempting to backtrack..." << std::endl;
-            if (!backtrack()) {
-                std::cout << "Backtrack failed. No solution found." << std::endl;
-                return false;
+    // 3. 选择边缘分布最大概率最高的单元格（并列时取可能模块较少的）
+    int best = -1;
+    double bestPeak = -1.0;
+    int bestSize = 0;
+    for (size_t i = 0; i < beliefCells.size(); ++i) {
+        int cell = beliefCells[i];
+        double total = 0.0, peak = 0.0;
+        for (int w = 0; w < wordsPerDomain; ++w) {
+            for (uint64_t bits = domainWord(cell, w); bits; bits &= bits - 1) {
+                int m = w * 64 + lowestBitIndex(bits);
+                double b = ruleset->getWeight(m);
+                for (int dir = 0; dir < COUNT; ++dir) b *= message(static_cast<int>(i), dir)[m];
+                total += b;
+                peak = std::max(peak, b);
             }
-            continue;
         }
+        peak = total > 0.0 ? peak / total : 1.0;
+        int size = domainSize(cell);
+        if (peak > bestPeak || (peak == bestPeak && size < bestSize)) {
+            best = static_cast<int>(i);
+            bestPeak = peak;
+            bestSize = size;
+        }
+    }
 
-        // 2. ̮Ԫ
-        std::string chosenModuleId;
-        if (!collapseCell(targetCell, chosenModuleId)) {
-            std::cout << "Collapse failed at (" << targetCell->x << ", " << targetCell->y << "), likely due to global constraints. Backtracking..." << std::endl;
-            if (!backtrack()) {
-                std::cout << "Backtrack failed. No solution found." << std::endl;
-                return false;
+    // 4. 保存被选单元格的边缘分布
+    int cell = beliefCells[best];
+    double total = 0.0;
+    std::fill(beliefMarginal.begin(), beliefMarginal.end(), 0.0);
+    for (int w = 0; w < wordsPerDomain; ++w) {
+        for (uint64_t bits = domainWord(cell, w); bits; bits &= bits - 1) {
+            int m = w * 64 + lowestBitIndex(bits);
+            double b = ruleset->getWeight(m);
+            for (int dir = 0; dir < COUNT; ++dir) b *= message(best, dir)[m];
+            beliefMarginal[m] = b;
+            total += b;
+        }
+    }
+    if (total > 0.0) beliefCell = cell;
+    return cell;
+}
+
+/**
+ * @brief 从并列的候选单元格中选出一个：默认随机选择，EntropyNearest 选择离上一次坍缩最近的。
+ * @param ctx 搜索上下文，候选单元格保存在 candidateCells 中（不能为空）。
+ * @return 选出的单元格索引。
+ */
+int WFCGenerator::pickCandidate(SearchContext& ctx) const {
+    if (options.cellSelection == CellSelection::EntropyNearest && ctx.lastCollapsed >= 0) {
+        int lastX, lastY;
+        layout.coordinatesOf(ctx.lastCollapsed, lastX, lastY);
+        int best = ctx.candidateCells[0];
+        int bestDistance = std::numeric_limits<int>::max();
+        for (int c : ctx.candidateCells) {
+            int x, y;
+            layout.coordinatesOf(c, x, y);
+            int distance = std::abs(x - lastX) + std::abs(y - lastY);
+            if (distance < bestDistance) {
+                bestDistance = distance;
+                best = c;
             }
-            continue;
         }
+        return best;
+    }
+    // 从候选者中随机选择一个
+    std::uniform_int_distribution<size_t> distrib(0, ctx.candidateCells.size() - 1);
+    return ctx.candidateCells[distrib(*ctx.rng)];
+}
 
-        // 浱ǰ״̬ԱܵĻ
-        saveState(targetCell, chosenModuleId);
+/**
+ * @brief 当前选择策略是否使用固定顺序（NearestToLast 以扫描线顺序作为后备）。
+ */
+bool WFCGenerator::usesSelectionOrder() const {
+    return options.cellSelection == CellSelection::Scanline || options.cellSelection == CellSelection::Spiral
+        || options.cellSelection == CellSelection::NearestToLast;
+}
 
-        // µԪ״̬
-        targetCell->isCollapsed = true;
-        targetCell->chosenModuleId = chosenModuleId;
-        targetCell->possibleModules = { chosenModuleId };
-        for (const auto& m : allModules) {
-            if (m.id == chosenModuleId) {
-                targetCell->module = &m;
-                break;
+/**
+ * @brief 按选择策略建立固定顺序：扫描线按行从上到下、行内从左到右；
+ * 螺旋按到网格中心的切比雪夫距离逐圈向外，圈内按角度排列。
+ */
+void WFCGenerator::buildSelectionOrder() {
+    int cellCount = width * height;
+    selectionOrder.clear();
+    selectionOrder.reserve(cellCount);
+    for (int y = 0; y < height; ++y) {
+        for (int x = 0; x < width; ++x) {
+            selectionOrder.push_back(layout.indexOf(x, y));
+        }
+    }
+    if (options.cellSelection == CellSelection::Spiral) {
+        // 坐标取两倍，使中心落在整数上
+        struct SpiralKey {
+            int ring;
+            double angle;
+            int cellIndex;
+        };
+        std::vector<SpiralKey> keys;
+        keys.reserve(cellCount);
+        for (int c : selectionOrder) {
+            int x, y;
+            layout.coordinatesOf(c, x, y);
+            int dx = 2 * x - (width - 1);
+            int dy = 2 * y - (height - 1);
+            keys.push_back({ std::max(std::abs(dx), std::abs(dy)), std::atan2(static_cast<double>(dy), static_cast<double>(dx)), c });
+        }
+        std::sort(keys.begin(), keys.end(), [](const SpiralKey& a, const SpiralKey& b) {
+            return a.ring != b.ring ? a.ring < b.ring : a.angle < b.angle;
+        });
+        for (int i = 0; i < cellCount; ++i) selectionOrder[i] = keys[i].cellIndex;
+    }
+    selectionRank.assign(cellCount, 0);
+    for (int i = 0; i < cellCount; ++i) selectionRank[selectionOrder[i]] = i;
+    selectionOrderPolicy = options.cellSelection;
+}
+
+/**
+ * @brief 单元格在搜索上下文的固定顺序中的位置。
+ * 根搜索直接使用整个网格的顺序；子问题的范围已按同一顺序排好，二分查找。
+ * @param ctx 搜索上下文。
+ * @param cellIndex 单元格索引。
+ * @return 位置。
+ */
+size_t WFCGenerator::orderPosition(const SearchContext& ctx, int cellIndex) const {
+    if (ctx.region.empty()) {
+        return static_cast<size_t>(selectionRank[cellIndex]);
+    }
+    auto it = std::lower_bound(ctx.region.begin(), ctx.region.end(), selectionRank[cellIndex],
+        [this](int c, int rank) { return selectionRank[c] < rank; });
+    return static_cast<size_t>(it - ctx.region.begin());
+}
+
+/**
+ * @brief 按固定顺序返回第一个未坍缩的单元格。
+ * 游标之前的单元格都已坍缩，游标只在撤销坍缩时回退，因此均摊 O(1)。
+ * @param ctx 搜索上下文。
+ * @return 单元格索引，如果所有单元格都已坍缩，则返回 -1。
+ */
+int WFCGenerator::getOrderedCell(SearchContext& ctx) {
+    const int* order = ctx.region.empty() ? selectionOrder.data() : ctx.region.data();
+    size_t count = ctx.region.empty() ? selectionOrder.size() : ctx.region.size();
+    while (ctx.orderCursor < count && results.isSet(order[ctx.orderCursor])) {
+        ++ctx.orderCursor;
+    }
+    return ctx.orderCursor < count ? order[ctx.orderCursor] : -1;
+}
+
+/**
+ * @brief 从上一次坍缩处按曼哈顿距离逐圈查找最近的未坍缩单元格，最远查找 nearestSearchRadius 圈。
+ * 子问题只考虑本区域的单元格。
+ * @param ctx 搜索上下文（lastCollapsed 不能为 -1）。
+ * @param requiredEntropy 要求的可能模块数量；0 表示不限，此时同一圈中取可能模块最少的。
+ * @return 单元格索引，范围内没有符合条件的单元格时返回 -1。
+ */
+int WFCGenerator::findNearestCell(SearchContext& ctx, int requiredEntropy) {
+    const SolverState& s = *state;
+    int centerX, centerY;
+    layout.coordinatesOf(ctx.lastCollapsed, centerX, centerY);
+    for (int radius = 1; radius <= options.nearestSearchRadius; ++radius) {
+        int best = -1;
+        int bestSize = moduleCount + 1;
+        auto consider = [&](int x, int y) {
+            if (x < 0 || x >= width || y < 0 || y >= height) return;
+            int c = layout.indexOf(x, y);
+            // 先排除其他分量的单元格：并行子搜索中它们的结果和可能模块由别的线程写入
+            if (ctx.component >= 0 && s.componentLabels[c] != ctx.component) return;
+            if (results.isSet(c)) return;
+            int size = domainSize(c);
+            if (size > 0 && size < bestSize && (requiredEntropy == 0 || size == requiredEntropy)) {
+                bestSize = size;
+                best = c;
             }
+        };
+        for (int dx = -radius; dx <= radius; ++dx) {
+            int dy = radius - std::abs(dx);
+            consider(centerX + dx, centerY + dy);
+            if (dy != 0) consider(centerX + dx, centerY - dy);
         }
-        globalModuleCounts[chosenModuleId]++;
+        if (best >= 0) return best;
+    }
+    return -1;
+}
+
+/**
+ * @brief 返回离上一次坍缩最近的未坍缩单元格，同一圈中取可能模块最少的。
+ * 附近没有未坍缩单元格时退回扫描线顺序。
+ * @param ctx 搜索上下文。
+ * @return 单元格索引，如果所有单元格都已坍缩，则返回 -1。
+ */
+int WFCGenerator::getNearestCell(SearchContext& ctx) {
+    if (ctx.lastCollapsed >= 0) {
+        int nearest = findNearestCell(ctx, 0);
+        if (nearest >= 0) return nearest;
+    }
+    return getOrderedCell(ctx);
+}
 
-        // ¼̮ĵԪ
-        collapsedCount = 0;
-        for (int i = 0; i < height; ++i) for (int j = 0; j < width; ++j) if (grid[i][j]->isCollapsed) collapsedCount++;
+/**
+ * @brief 查找并返回可能模块数与冲突加权度之比最小的未坍缩单元格（dom/wdeg）。
+ * 只剩一个可能模块的单元格不需要选择，直接返回；没有未坍缩邻居的单元格排在最后。
+ * 并列的单元格中随机选择一个。
+ * @param ctx 搜索上下文。
+ * @return 单元格索引，如果所有单元格都已坍缩，则返回 -1。
+ */
+int WFCGenerator::getDomWDegCell(SearchContext& ctx) {
+    double bestScore = 0.0;
+    ctx.candidateCells.clear();
 
-        // 3. Լ
-        if (!propagate(targetCell->x, targetCell->y)) {
-            std::cout << "Propagation led to a contradiction. Backtracking..." << std::endl;
-            if (!backtrack()) {
-                std::cout << "Backtrack failed. No solution found." << std::endl;
-                return false;
+    auto consider = [&](int c) {
+        if (results.isSet(c)) return;
+        int size = domainSize(c);
+        if (size == 0) return;
+        double score = 0.0;
+        if (size > 1) {
+            double weightedDegree = 0.0;
+            for (int i = 0; i < COUNT; ++i) {
+                int neighbor = layout.neighbor(c, i);
+                if (neighbor >= 0 && !results.isSet(neighbor)) weightedDegree += edgeWeights[static_cast<size_t>(c) * COUNT + i];
             }
-            // ݺҪ¼̮ĵԪ
-            collapsedCount = 0;
-            for (int i = 0; i < height; ++i) for (int j = 0; j < width; ++j) if (grid[i][j]->isCollapsed) collapsedCount++;
+            score = weightedDegree > 0.0 ? size / weightedDegree : std::numeric_limits<double>::infinity();
+        }
+        if (ctx.candidateCells.empty() || score < bestScore) {
+            bestScore = score;
+            ctx.candidateCells.clear();
+            ctx.candidateCells.push_back(c);
+        }
+        else if (score == bestScore) {
+            ctx.candidateCells.push_back(c);
         }
+    };
+    if (ctx.region.empty()) {
+        for (int c = 0; c < width * height; ++c) consider(c);
+    }
+    else {
+        for (int c : ctx.region) consider(c);
+    }
+
+    if (ctx.candidateCells.empty()) {
+        return -1;
+    }
+    std::uniform_int_distribution<size_t> distrib(0, ctx.candidateCells.size() - 1);
+    return ctx.candidateCells[distrib(*ctx.rng)];
+}
+
+/**
+ * @brief 增加导致当前矛盾的相邻关系的冲突权重（只由根搜索调用，子问题只读取权重）。
+ * 变空的单元格最后一次被移除模块时，如果原因是某个邻居，只增加这条相邻关系的权重；
+ * 否则（由决策集合移除，或由可达掩码按较远的坍缩单元格移除）增加该单元格所有相邻关系的权重。
+ * @param ctx 搜索上下文。
+ */
+void WFCGenerator::bumpConflictWeights(SearchContext& ctx) {
+    if (&ctx != &state->root || !ctx.hasContradiction()) return;
+    int cell = ctx.conflictCell;
+    int cause = -1;
+    for (size_t i = ctx.trail.size(); i > 0; --i) {
+        const TrailEntry& entry = ctx.trail[i - 1];
+        if (entry.cellIndex == cell && !entry.isCollapse) {
+            cause = entry.reason;
+            break;
+        }
+    }
+    bool adjacentCause = false;
+    for (int i = 0; i < COUNT && cause >= 0; ++i) adjacentCause |= layout.neighbor(cell, i) == cause;
+    if (!adjacentCause) cause = -1;
+
+    for (int i = 0; i < COUNT; ++i) {
+        int neighbor = layout.neighbor(cell, i);
+        if (neighbor < 0 || (cause >= 0 && neighbor != cause)) continue;
+        edgeWeights[static_cast<size_t>(cell) * COUNT + i] += weightIncrement;
+        for (int j = 0; j < COUNT; ++j) {
+            if (layout.neighbor(neighbor, j) == cell) edgeWeights[static_cast<size_t>(neighbor) * COUNT + j] += weightIncrement;
+        }
+    }
+
+    // 放大增量代替衰减全部旧权重；增量过大时整体缩小
+    weightIncrement /= options.conflictWeightDecay;
+    if (weightIncrement > 1e100) {
+        for (double& weight : edgeWeights) weight *= 1e-100;
+        weightIncrement *= 1e-100;
+    }
+}
+
+/**
+ * @brief 根据权重和全局限制，为单元格选择一个模块进行坍缩。
+ * @param ctx 搜索上下文。
+ * @param cellIndex 要坍缩的单元格索引。
+ * @param chosenModule [out] 用于存储选定模块索引的引用。
+ * @return 如果成功选择一个模块，返回 true，否则返回 false。
+ */
+bool WFCGenerator::collapseCell(SearchContext& ctx, int cellIndex, int& chosenModule) {
+    SolverState& s = *state;
+    if (domainSize(cellIndex) == 0) {
+        return false;
+    }
+
+    ctx.candidateModules.clear();
+    ctx.candidateWeights.clear();
+    double totalWeight = 0.0;
+
+    // 遍历所有可能的模块，筛选出符合全局限制的模块
+    for (int w = 0; w < wordsPerDomain; ++w) {
+        for (uint64_t bits = domainWord(cellIndex, w); bits; bits &= bits - 1) {
+            int m = w * 64 + lowestBitIndex(bits);
+            // 如果模块有全局限制，并且当前数量已达到上限，则跳过
+            if (s.moduleLimits[m] >= 0 && ctx.moduleCounts[m] >= s.moduleLimits[m]) {
+                continue;
+            }
+            // 信念传播选出的单元格按其边缘分布抽样
+            double weight = cellIndex == beliefCell && &ctx == &s.root ? beliefMarginal[m] : ruleset->getWeight(m);
+            ctx.candidateModules.push_back(m);
+            ctx.candidateWeights.push_back(weight);
+            totalWeight += weight;
+        }
+    }
+
+    if (ctx.candidateModules.empty()) {
+        return false; // 没有可用的模块可选
+    }
+
+    // 最少约束值：按邻居保留的可能模块比例调整权重
+    if (options.leastConstrainingValue && ctx.candidateModules.size() > 1) {
+        int neighborTotal = 0;
+        for (int i = 0; i < COUNT; ++i) {
+            int neighbor = layout.neighbor(cellIndex, i);
+            if (neighbor >= 0 && !results.isSet(neighbor)) neighborTotal += domainSize(neighbor);
+        }
+        if (neighborTotal > 0) {
+            totalWeight = 0.0;
+            for (size_t k = 0; k < ctx.candidateModules.size(); ++k) {
+                int retained = 0;
+                for (int i = 0; i < COUNT; ++i) retained += countRetained(cellIndex, ctx.candidateModules[k], i);
+                ctx.candidateWeights[k] *= std::pow(static_cast<double>(retained) / neighborTotal, options.lcvBias);
+                totalWeight += ctx.candidateWeights[k];
+            }
+        }
+    }
+
+    // 按权重随机选择一个模块（累积权重抽样，不额外分配内存）
+    std::uniform_real_distribution<double> distrib(0.0, totalWeight);
+    double r = distrib(*ctx.rng);
+    chosenModule = ctx.candidateModules.back();
+    for (size_t i = 0; i < ctx.candidateModules.size(); ++i) {
+        r -= ctx.candidateWeights[i];
+        if (r < 0.0) {
+            chosenModule = ctx.candidateModules[i];
+            break;
+        }
+    }
+
+    return true;
+}
+
+/**
+ * @brief 统计单元格坍缩为某模块后，某方向上的未坍缩邻居还能保留多少可能模块。
+ * 稠密兼容行与邻居位集按字求交；稀疏兼容行逐个检查。
+ * @param cellIndex 单元格索引。
+ * @param module 候选模块索引。
+ * @param dir 方向。
+ * @return 保留的可能模块数量；邻居不存在或已坍缩时返回 0。
+ */
+int WFCGenerator::countRetained(int cellIndex, int module, int dir) const {
+    int neighbor = layout.neighbor(cellIndex, dir);
+    if (neighbor < 0 || results.isSet(neighbor)) return 0;
+    int retained = 0;
+    if (const uint64_t* row = ruleset->getDenseRow(module, dir)) {
+        for (int w = 0; w < wordsPerDomain; ++w) retained += popCount64(domainWord(neighbor, w) & row[w]);
+    }
+    else {
+        int count = 0;
+        const int* indices = ruleset->getSparseRow(module, dir, count);
+        for (int k = 0; k < count; ++k) retained += hasDomainBit(neighbor, indices[k]);
+    }
+    return retained;
+}
+
+/**
+ * @brief 把单元格坍缩为指定模块：移除其余可能模块，并更新全局计数。
+ * @param ctx 搜索上下文。
+ * @param cellIndex 单元格索引。
+ * @param module 选定的模块索引。
+ */
+void WFCGenerator::assignModule(SearchContext& ctx, int cellIndex, int module) {
+    for (int w = 0; w < wordsPerDomain; ++w) {
+        uint64_t bits = domainWord(cellIndex, w);
+        if (w == module / 64) bits &= ~(uint64_t(1) << (module % 64));
+        for (; bits; bits &= bits - 1) {
+            removeModule(ctx, cellIndex, w * 64 + lowestBitIndex(bits), -1);
+        }
+    }
+
+    results.set(cellIndex, module);
+    ctx.moduleCounts[module]++;
+    ctx.collapsedCount++;
+    ctx.trail.push_back({ cellIndex, module, true });
+    updateEntropyBucket(ctx, cellIndex);
+    if (isLearning(ctx)) checkNogoods(ctx, cellIndex, module);
+    if (reachability) pruneByReachability(ctx, cellIndex, module);
+}
+
+/**
+ * @brief 按可达掩码移除坍缩单元格周围 2 到 radius 距离内不可能出现的模块。
+ * 被修改的单元格加入待传播的起点，由随后的传播把影响继续扩散；
+ * 子问题只修改自己区域内的单元格，避免与并行的其他区域交叉。
+ * @param ctx 搜索上下文。
+ * @param cellIndex 刚坍缩的单元格索引。
+ * @param module 坍缩成的模块索引。
+ */
+void WFCGenerator::pruneByReachability(SearchContext& ctx, int cellIndex, int module) {
+    int x, y;
+    layout.coordinatesOf(cellIndex, x, y);
+    for (int i = 0; i < reachability->getOffsetCount(); ++i) {
+        const ReachabilityTable::Offset& offset = reachability->getOffset(i);
+        int tx = x + offset.dx, ty = y + offset.dy;
+        if (tx < 0 || tx >= width || ty < 0 || ty >= height) continue;
+        int target = layout.indexOf(tx, ty);
+        if (ctx.component >= 0 && state->componentLabels[target] != ctx.component) continue; // 先于读取结果，见 findNearestCell
+        if (results.isSet(target)) continue;
+
+        const uint64_t* mask = reachability->getMask(i, module);
+        bool pruned = false;
+        for (int w = 0; w < wordsPerDomain; ++w) {
+            for (uint64_t bits = domainWord(target, w) & ~mask[w]; bits; bits &= bits - 1) {
+                removeModule(ctx, target, w * 64 + lowestBitIndex(bits), cellIndex);
+                if (&ctx == &state->root) stats.reachabilityPrunes++;
+                pruned = true;
+            }
+        }
+        if (pruned) ctx.pendingCells.push_back(target);
+    }
+}
+
+/**
+ * @brief 从一个点开始，向外传播约束。
+ * 当一个单元格的状态改变时，此函数会更新其邻居的可能模块集合：
+ * 邻居只保留能被当前单元格某个可能模块支持的模块。
+ * 传播不会越过已坍缩的单元格，因此不同连通区域的传播互不干扰。
+ * 坍缩时被 nogood 移除了模块的单元格也一并作为起点。
+ * @param ctx 搜索上下文。
+ * @param startIndex 起始单元格的索引。
+ * @return 如果传播没有导致矛盾（即没有单元格的可能模块变为空），返回 true。
+ */
+bool WFCGenerator::propagate(SearchContext& ctx, int startIndex) {
+    SolverState& s = *state;
+    // 使用栈来处理需要更新的单元格；每个单元格同时最多在栈中出现一次
+    ctx.propagationStack.clear();
+    ctx.propagationStack.push_back(startIndex);
+    s.inPropagationStack[startIndex] = 1;
+    for (int c : ctx.pendingCells) {
+        if (s.inPropagationStack[c]) continue;
+        ctx.propagationStack.push_back(c);
+        s.inPropagationStack[c] = 1;
+    }
+    ctx.pendingCells.clear();
+
+    bool ok = !ctx.hasContradiction();
+    while (ok && !ctx.propagationStack.empty()) {
+        int current = ctx.propagationStack.back();
+        ctx.propagationStack.pop_back();
+        s.inPropagationStack[current] = 0;
+
+        for (int i = 0; i < COUNT && ok; ++i) {
+            int neighbor = layout.neighbor(current, i);
+            if (neighbor < 0 || results.isSet(neighbor)) continue;
+
+            bool changed = false;
+            if (interning) {
+                // 合并存储：支持并集和交集都是记忆化的查表，被移除的模块逐个记录到轨迹中
+                DomainInterner::Handle& neighborHandle = s.domainHandles[neighbor];
+                DomainInterner::Handle restricted = interner->intersect(neighborHandle, interner->supportUnion(s.domainHandles[current], i));
+                if (restricted != neighborHandle) {
+                    const uint64_t* before = interner->getWords(neighborHandle);
+                    const uint64_t* after = interner->getWords(restricted);
+                    for (int w = 0; w < wordsPerDomain; ++w) {
+                        for (uint64_t bits = before[w] & ~after[w]; bits; bits &= bits - 1) {
+                            ctx.trail.push_back({ neighbor, w * 64 + lowestBitIndex(bits), false, current });
+                        }
+                    }
+                    neighborHandle = restricted;
+                    updateEntropyBucket(ctx, neighbor);
+                    if (interner->getSize(restricted) == 0 && ctx.emptyCells++ == 0) ctx.conflictCell = neighbor;
+                    changed = true;
+                }
+            }
+            else {
+                // 当前单元格所有可能模块在该方向上支持的邻居模块并集；跨多个类别时只按类别约束
+                const uint64_t* support = categoryStage ? categorySupport(ctx, current, i) : nullptr;
+                if (!support) support = supportUnion(ctx, current, i);
+
+                // 移除邻居中没有任何支持的模块
+                for (int w = 0; w < wordsPerDomain; ++w) {
+                    for (uint64_t bits = domainWord(neighbor, w) & ~support[w]; bits; bits &= bits - 1) {
+                        removeModule(ctx, neighbor, w * 64 + lowestBitIndex(bits), current);
+                        changed = true;
+                    }
+                }
+            }
+
+            // 如果邻居的状态发生了变化，将其加入栈中以便进一步传播
+            if (changed) {
+                if (ctx.hasContradiction()) {
+                    ok = false; // 出现矛盾，传播失败
+                }
+                else if (!s.inPropagationStack[neighbor]) {
+                    ctx.propagationStack.push_back(neighbor);
+                    s.inPropagationStack[neighbor] = 1;
+                }
+            }
+        }
+    }
+
+    // 清理残留的栈标记，供下一次传播使用
+    for (int c : ctx.propagationStack) s.inPropagationStack[c] = 0;
+    ctx.propagationStack.clear();
+    return ok;
+}
+
+/**
+ * @brief 在坍缩一个单元格之前，保存回溯点。
+ * @param ctx 搜索上下文。
+ * @param cellIndex 即将坍缩的单元格索引。
+ * @param chosenModule 为该单元格选择的模块索引。
+ */
+void WFCGenerator::saveState(SearchContext& ctx, int cellIndex, int chosenModule) {
+    ctx.decisions.push_back({ cellIndex, chosenModule, ctx.trail.size() });
+}
+
+/**
+ * @brief 执行回溯。
+ * 当遇到矛盾时，撤销到上一个回溯点，并从失败的选择中移除该选项。
+ * 如果移除后仍然矛盾，则继续向更早的回溯点回退。
+ * @param ctx 搜索上下文。
+ * @return 如果回溯成功并且传播没有引发新的矛盾，返回 true。
+ */
+bool WFCGenerator::backtrack(SearchContext& ctx) {
+    while (!ctx.decisions.empty()) {
+        StateSnapshot lastState = ctx.decisions.back();
+        ctx.decisions.pop_back();
+        if (&ctx == &state->root) stats.backtracks++;
+
+        // 撤销该决策之后的所有修改
+        undoTrail(ctx, lastState.trailMark);
+
+        // 从导致失败的单元格的可能模块中，移除那个失败的选择（记录在上一层回溯点的轨迹中）；
+        // 冲突学习时以其余全部决策作为原因
+        int reason = -1;
+        if (isLearning(ctx) && hasDomainBit(lastState.cellIndex, lastState.attemptedModule)) reason = pushDecisionsReason(ctx);
+        removeModule(ctx, lastState.cellIndex, lastState.attemptedModule, reason);
+
+        // 如果移除后该单元格已没有其他可能性，则需要进一步回溯
+        if (ctx.hasContradiction()) {
+            continue;
+        }
+
+        int x, y;
+        layout.coordinatesOf(lastState.cellIndex, x, y);
+        std::cout << "Backtracking from cell (" << x << ", " << y
+            << "). Removed module " << ruleset->getModule(lastState.attemptedModule).id << " from possibilities." << std::endl;
+
+        // 从失败的单元格开始重新传播约束
+        requeueBatch(ctx, lastState);
+        if (propagate(ctx, lastState.cellIndex)) {
+            return true;
+        }
+    }
+    return false; // 没有可回溯的状态
+}
+
+/**
+ * @brief 批量坍缩：从最低熵的段中选出一批两两曼哈顿距离大于 2 的单元格，逐个坍缩后从它们一起传播。
+ * 批中的单元格没有公共邻居，坍缩时互不影响；每个坍缩都作为一个决策保存，之后可以像单步坍缩一样逐个回溯。
+ * 一起传播失败时撤销整批并把批量上限减半，交给单步坍缩；成功时上限加倍（不超过 batchSize）。
+ * @param ctx 搜索上下文（只用于根搜索）。
+ * @return 如果一批（至少两个）单元格坍缩并传播成功，返回 true。
+ */
+bool WFCGenerator::collapseBatch(SearchContext& ctx) {
+    SolverState& s = *state;
+    if (batchLimit < 2) {
+        batchLimit = 2; // 上一批失败后先走一步单步坍缩，再从最小的批量重新尝试
+        return false;
+    }
+
+    // 1. 在最低的非空熵段中从随机位置开始选择，已选单元格附近（距离不超过 2）的单元格被排除
+    int key = 1;
+    while (key <= moduleCount && s.entropyStarts[key] == s.entropyStarts[key + 1]) ++key;
+    if (key > moduleCount) return false;
+    int first = s.entropyStarts[key];
+    int count = s.entropyStarts[key + 1] - first;
+    if (count < 2) return false;
+
+    int stamp = ++batchStamp;
+    ctx.batchCells.clear();
+    int offset = std::uniform_int_distribution<int>(0, count - 1)(*ctx.rng);
+    for (int k = 0; k < count && static_cast<int>(ctx.batchCells.size()) < batchLimit; ++k) {
+        int c = s.entropyCells[first + (offset + k) % count];
+        if (batchMarks[c] == stamp) continue;
+        ctx.batchCells.push_back(c);
+        int cx, cy;
+        layout.coordinatesOf(c, cx, cy);
+        for (int dy = -2; dy <= 2; ++dy) {
+            for (int dx = std::abs(dy) - 2; dx <= 2 - std::abs(dy); ++dx) {
+                int x = cx + dx, y = cy + dy;
+                if (x >= 0 && x < width && y >= 0 && y < height) batchMarks[layout.indexOf(x, y)] = stamp;
+            }
+        }
+    }
+    if (ctx.batchCells.size() < 2) return false;
+
+    // 2. 逐个坍缩
+    size_t level = ctx.decisions.size();
+    size_t mark = ctx.trail.size();
+    bool ok = true;
+    for (int c : ctx.batchCells) {
+        int chosenModule = -1;
+        if (!collapseCell(ctx, c, chosenModule)) {
+            ok = false;
+            break;
+        }
+        saveState(ctx, c, chosenModule);
+        ctx.decisions.back().batched = ctx.decisions.size() > level + 1;
+        assignModule(ctx, c, chosenModule);
+        ctx.lastCollapsed = c;
+        ctx.pendingCells.push_back(c);
+    }
+
+    // 3. 从所有坍缩的单元格一起传播
+    if (ok) {
+        int start = ctx.pendingCells.back();
+        ctx.pendingCells.pop_back();
+        ok = propagate(ctx, start);
+    }
+    if (!ok) {
+        ctx.pendingCells.clear();
+        ctx.decisions.resize(level);
+        undoTrail(ctx, mark);
+        stats.batchRollbacks++;
+        batchLimit /= 2;
+        return false;
+    }
+    stats.batches++;
+    stats.batchedCells += static_cast<long long>(ctx.batchCells.size());
+    batchLimit = std::min(options.batchSize, batchLimit * 2);
+    return true;
+}
+
+/**
+ * @brief 批中的决策在保存时，前面的同批决策只坍缩了还没有传播。回溯撤销到批中间的决策时，
+ * 把前面的同批单元格加入待传播的起点，使它们的约束随本次传播重新生效。
+ * @param ctx 搜索上下文。
+ * @param undone 刚被撤销的决策。
+ */
+void WFCGenerator::requeueBatch(SearchContext& ctx, const StateSnapshot& undone) {
+    if (!undone.batched) return;
+    for (size_t i = ctx.decisions.size(); i-- > 0;) {
+        ctx.pendingCells.push_back(ctx.decisions[i].cellIndex);
+        if (!ctx.decisions[i].batched) break;
+    }
+}
+
+/**
+ * @brief 在轨迹上试探把单元格坍缩为指定模块并传播，随后撤销全部修改。
+ * 试探失败且进行冲突学习时，conflictLiterals 中保存导致矛盾的决策集合（含试探本身）。
+ * @param ctx 搜索上下文。
+ * @param cellIndex 试探的单元格索引。
+ * @param module 试探的模块索引。
+ * @return 如果试探没有导致矛盾，返回 true。
+ */
+bool WFCGenerator::probeModule(SearchContext& ctx, int cellIndex, int module) {
+    stats.lookaheadProbes++;
+    size_t mark = ctx.trail.size();
+    assignModule(ctx, cellIndex, module);
+    bool ok = propagate(ctx, cellIndex);
+    if (!ok && isLearning(ctx)) {
+        analyzeConflict(ctx);
+    }
+    undoTrail(ctx, mark);
+    return ok;
+}
+
+/**
+ * @brief 单例弧相容前瞻：逐个试探坍缩单元格附近单元格的可能模块，移除试探失败的模块并传播。
+ * 试探范围沿未坍缩的单元格扩展，因此只覆盖与该次坍缩有约束联系的单元格。
+ * @param ctx 搜索上下文。
+ * @param cellIndex 刚坍缩的单元格索引。
+ * @return 如果前瞻没有发现矛盾，返回 true；否则矛盾保留在上下文中，交给回溯处理。
+ */
+bool WFCGenerator::lookahead(SearchContext& ctx, int cellIndex) {
+    // 1. 按邻接步数逐层收集试探范围
+    ctx.lookaheadCells.clear();
+    ctx.lookaheadCells.push_back(cellIndex);
+    size_t layerStart = 0;
+    for (int depth = 0; depth < options.lookaheadRadius; ++depth) {
+        size_t layerEnd = ctx.lookaheadCells.size();
+        for (size_t k = layerStart; k < layerEnd; ++k) {
+            for (int i = 0; i < COUNT; ++i) {
+                int neighbor = layout.neighbor(ctx.lookaheadCells[k], i);
+                if (neighbor < 0 || results.isSet(neighbor)) continue;
+                if (std::find(ctx.lookaheadCells.begin(), ctx.lookaheadCells.end(), neighbor) != ctx.lookaheadCells.end()) continue;
+                ctx.lookaheadCells.push_back(neighbor);
+            }
+        }
+        layerStart = layerEnd;
+    }
+
+    // 2. 逐个试探，失败的模块以试探得到的决策集合为原因移除
+    int budget = options.lookaheadBudget;
+    for (size_t k = 1; k < ctx.lookaheadCells.size() && budget > 0; ++k) {
+        int cell = ctx.lookaheadCells[k];
+        ctx.candidateModules.clear();
+        for (int w = 0; w < wordsPerDomain; ++w) {
+            for (uint64_t bits = domainWord(cell, w); bits; bits &= bits - 1) {
+                ctx.candidateModules.push_back(w * 64 + lowestBitIndex(bits));
+            }
+        }
+        for (int module : ctx.candidateModules) {
+            // 之前的移除可能已经缩小了该单元格的可能模块；只剩一个时传播已经完成了它的全部推论
+            if (budget <= 0 || domainSize(cell) < 2) break;
+            if (!hasDomainBit(cell, module)) continue;
+            --budget;
+            if (probeModule(ctx, cell, module)) continue;
+
+            const auto& literals = state->conflictLiterals;
+            int reason = isLearning(ctx) ? pushReason(literals.data(), static_cast<int>(literals.size()), cell) : -1;
+            removeModule(ctx, cell, module, reason);
+            stats.lookaheadPrunes++;
+            if (!propagate(ctx, cell)) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief 把一组决策作为移除原因压入原因池。
+ * @param literals 决策数组。
+ * @param count 决策数量。
+ * @param skipCell 不计入原因的决策单元格（被移除模块所在的单元格），-1 表示全部计入。
+ * @return 编码后的原因（-2 - 在原因池中的起点）。
+ */
+int WFCGenerator::pushReason(const NogoodLiteral* literals, int count, int skipCell) {
+    auto& reasonPool = state->reasonPool;
+    int offset = static_cast<int>(reasonPool.size());
+    reasonPool.push_back(0);
+    for (int i = 0; i < count; ++i) {
+        if (literals[i].cellIndex == skipCell) continue;
+        reasonPool.push_back(literals[i].cellIndex);
+        reasonPool.push_back(literals[i].moduleIndex);
+        reasonPool[offset]++;
+    }
+    return -2 - offset;
+}
+
+/**
+ * @brief 以当前全部决策作为移除原因（按时间顺序回溯时使用）。
+ * @param ctx 搜索上下文。
+ * @return 编码后的原因。
+ */
+int WFCGenerator::pushDecisionsReason(const SearchContext& ctx) {
+    auto& reasonPool = state->reasonPool;
+    int offset = static_cast<int>(reasonPool.size());
+    reasonPool.push_back(static_cast<int>(ctx.decisions.size()));
+    for (const StateSnapshot& decision : ctx.decisions) {
+        reasonPool.push_back(decision.cellIndex);
+        reasonPool.push_back(decision.attemptedModule);
+    }
+    return -2 - offset;
+}
+
+/**
+ * @brief 冲突分析：从变为空的单元格出发，沿轨迹逆序追溯移除原因，求出导致矛盾的决策集合。
+ * 一个单元格的可能模块只取决于它此前的移除记录，因此只需检查被标记单元格的记录：
+ * 由邻居传播引起的移除标记该邻居，由决策集合引起的移除直接把这些决策加入结果，
+ * 被标记单元格自身的坍缩就是结果中的一个决策。第一个决策之前的修改与决策无关，不再追溯。
+ * 结果保存在 conflictLiterals 中，其单元格以 literalMarks 标记。
+ * @param ctx 搜索上下文。
+ */
+void WFCGenerator::analyzeConflict(SearchContext& ctx) {
+    SolverState& s = *state;
+    int stamp = ++conflictStamp;
+    s.conflictLiterals.clear();
+    auto addLiteral = [&](int cell, int module) {
+        if (literalMarks[cell] == stamp) return;
+        literalMarks[cell] = stamp;
+        s.conflictLiterals.push_back({ cell, module });
+    };
+
+    conflictMarks[ctx.conflictCell] = stamp;
+    size_t floor = ctx.decisions.empty() ? ctx.trail.size() : ctx.decisions.front().trailMark;
+    for (size_t i = ctx.trail.size(); i > floor; --i) {
+        const TrailEntry& entry = ctx.trail[i - 1];
+        if (conflictMarks[entry.cellIndex] != stamp) continue;
+        if (entry.isCollapse) {
+            addLiteral(entry.cellIndex, entry.moduleIndex);
+        }
+        else if (entry.reason >= 0) {
+            conflictMarks[entry.reason] = stamp;
+        }
+        else if (entry.reason <= -2) {
+            const int* reason = &s.reasonPool[-2 - entry.reason];
+            for (int k = 0; k < reason[0]; ++k) addLiteral(reason[1 + 2 * k], reason[2 + 2 * k]);
+        }
+    }
+}
+
+/**
+ * @brief 保存冲突分析得到的 nogood。
+ * 只含一个决策的 nogood 在重启后直接应用；其余的把最晚和次晚的决策放在前两位作为观察文字，
+ * 回跳后最晚的决策被撤销，次晚的决策仍然成立。
+ * @param ctx 搜索上下文。
+ * @param latestLevel 结果中最晚的决策所在的层级。
+ */
+void WFCGenerator::learnNogood(const SearchContext& ctx, int latestLevel) {
+    SolverState& s = *state;
+    int count = static_cast<int>(s.conflictLiterals.size());
+    if (count == 1) {
+        s.unitNogoods.push_back(s.conflictLiterals[0]);
+        stats.learnedNogoods++;
+        return;
+    }
+    if (count > options.maxNogoodSize || static_cast<int>(s.nogoodStarts.size()) > options.maxNogoods) {
+        return;
+    }
+
+    // 找出次晚的决策
+    int secondLevel = latestLevel - 1;
+    while (literalMarks[ctx.decisions[secondLevel].cellIndex] != conflictStamp) --secondLevel;
+    int latestCell = ctx.decisions[latestLevel].cellIndex;
+    int secondCell = ctx.decisions[secondLevel].cellIndex;
+
+    int id = static_cast<int>(s.nogoodStarts.size()) - 1;
+    size_t start = s.nogoodLiterals.size();
+    s.nogoodLiterals.insert(s.nogoodLiterals.end(), s.conflictLiterals.begin(), s.conflictLiterals.end());
+    NogoodLiteral* lits = &s.nogoodLiterals[start];
+    for (int i = 0; i < count; ++i) {
+        if (lits[i].cellIndex == latestCell) std::swap(lits[i], lits[0]);
+    }
+    for (int i = 1; i < count; ++i) {
+        if (lits[i].cellIndex == secondCell) std::swap(lits[i], lits[1]);
+    }
+    s.nogoodStarts.push_back(static_cast<int>(s.nogoodLiterals.size()));
+
+    // 观察项 id * 2 + k 挂到第 k 个观察文字的单元格的链表头
+    for (int k = 0; k < 2; ++k) {
+        s.watchNext.push_back(s.watchHeads[lits[k].cellIndex]);
+        s.watchHeads[lits[k].cellIndex] = id * 2 + k;
+    }
+    stats.learnedNogoods++;
+}
+
+/**
+ * @brief 单元格坍缩后检查观察该决策的 nogood（双观察文字）。
+ * 观察文字变为成立时，寻找一个尚未成立的文字替换它；找不到时，除另一个观察文字外的决策都已成立，
+ * 于是从另一个观察文字的单元格中移除对应模块，该单元格留待传播。
+ * @param ctx 搜索上下文。
+ * @param cellIndex 刚坍缩的单元格索引。
+ * @param module 坍缩的模块索引。
+ */
+void WFCGenerator::checkNogoods(SearchContext& ctx, int cellIndex, int module) {
+    SolverState& s = *state;
+    int* link = &s.watchHeads[cellIndex];
+    while (*link >= 0) {
+        int watch = *link;
+        int id = watch / 2;
+        NogoodLiteral* lits = &s.nogoodLiterals[s.nogoodStarts[id]];
+        int count = s.nogoodStarts[id + 1] - s.nogoodStarts[id];
+        if (lits[1].cellIndex == cellIndex) std::swap(lits[0], lits[1]);
+        if (lits[0].moduleIndex != module) {
+            link = &s.watchNext[watch]; // 该决策与 nogood 不同，nogood 已满足
+            continue;
+        }
+
+        // 寻找尚未成立的文字替换观察：把观察项从本单元格的链表移到新单元格的链表头
+        int replacement = -1;
+        for (int k = 2; k < count && replacement < 0; ++k) {
+            if (!results.isSet(lits[k].cellIndex) || results.get(lits[k].cellIndex) != lits[k].moduleIndex) replacement = k;
+        }
+        if (replacement >= 0) {
+            std::swap(lits[0], lits[replacement]);
+            *link = s.watchNext[watch];
+            s.watchNext[watch] = s.watchHeads[lits[0].cellIndex];
+            s.watchHeads[lits[0].cellIndex] = watch;
+            continue;
+        }
+
+        // 其余决策都已成立：另一个观察文字不能成立
+        const NogoodLiteral& other = lits[1];
+        if (!results.isSet(other.cellIndex) && hasDomainBit(other.cellIndex, other.moduleIndex)) {
+            removeModule(ctx, other.cellIndex, other.moduleIndex, pushReason(lits, count, other.cellIndex));
+            ctx.pendingCells.push_back(other.cellIndex);
+            stats.nogoodPrunes++;
+        }
+        link = &s.watchNext[watch];
+    }
+}
+
+/**
+ * @brief 冲突学习并回跳。
+ * 分析矛盾得到决策集合，撤销其中最晚的决策及之后的所有决策，并以其余决策为原因移除该决策的模块；
+ * 移除后仍然矛盾则继续分析。
+ * @param ctx 搜索上下文。
+ * @return 如果回跳后传播没有引发新的矛盾，返回 true；决策集合为空时问题无解，返回 false。
+ */
+bool WFCGenerator::resolveConflict(SearchContext& ctx) {
+    while (ctx.hasContradiction()) {
+        stats.conflicts++;
+        conflictsSinceRestart++;
+        analyzeConflict(ctx);
+
+        int level = static_cast<int>(ctx.decisions.size()) - 1;
+        while (level >= 0 && literalMarks[ctx.decisions[level].cellIndex] != conflictStamp) --level;
+        if (level < 0) {
+            std::cout << "Conflict does not depend on any decision. No solution found." << std::endl;
+            return false;
+        }
+        learnNogood(ctx, level);
+
+        StateSnapshot decision = ctx.decisions[level];
+        ctx.decisions.resize(level);
+        stats.backtracks++;
+        undoTrail(ctx, decision.trailMark);
+        if (hasDomainBit(decision.cellIndex, decision.attemptedModule)) {
+            const auto& literals = state->conflictLiterals;
+            int reason = pushReason(literals.data(), static_cast<int>(literals.size()), decision.cellIndex);
+            removeModule(ctx, decision.cellIndex, decision.attemptedModule, reason);
+        }
+
+        int x, y;
+        layout.coordinatesOf(decision.cellIndex, x, y);
+        std::cout << "Backjumping to cell (" << x << ", " << y << ") with a nogood of " << state->conflictLiterals.size()
+            << " decisions. Removed module " << ruleset->getModule(decision.attemptedModule).id << " from possibilities." << std::endl;
+
+        if (!ctx.hasContradiction()) {
+            requeueBatch(ctx, decision);
+            if (propagate(ctx, decision.cellIndex)) {
+                return true;
+            }
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief 重启：撤销全部决策，重新应用只含一个决策的 nogood 并传播。
+ * 其余 nogood 保留，在之后的坍缩中继续剪枝。
+ * @param ctx 搜索上下文。
+ * @return 如果重新传播没有矛盾，返回 true；否则问题无解。
+ */
+bool WFCGenerator::restart(SearchContext& ctx) {
+    stats.restarts++;
+    conflictsSinceRestart = 0;
+    std::cout << "Restarting search after " << stats.conflicts << " conflicts." << std::endl;
+
+    ctx.decisions.clear();
+    undoTrail(ctx, 0);
+    for (const NogoodLiteral& unit : state->unitNogoods) {
+        if (!hasDomainBit(unit.cellIndex, unit.moduleIndex)) continue;
+        removeModule(ctx, unit.cellIndex, unit.moduleIndex, pushReason(nullptr, 0, -1));
+        ctx.pendingCells.push_back(unit.cellIndex);
+    }
+    if (ctx.pendingCells.empty()) {
+        return true;
+    }
+    int start = ctx.pendingCells.back();
+    ctx.pendingCells.pop_back();
+    return propagate(ctx, start) || resolveConflict(ctx);
+}
+
+/**
+ * @brief 清空上一次生成学到的 nogood 和原因池。
+ */
+void WFCGenerator::resetNogoods() {
+    SolverState& s = *state;
+    int cellCount = width * height;
+    s.nogoodLiterals.clear();
+    s.nogoodStarts.assign(1, 0);
+    s.unitNogoods.clear();
+    s.watchHeads.assign(cellCount, -1);
+    s.watchNext.clear();
+    s.reasonPool.clear();
+    s.conflictLiterals.clear();
+    conflictMarks.assign(cellCount, 0);
+    literalMarks.assign(cellCount, 0);
+    conflictStamp = 0;
+    conflictsSinceRestart = 0;
+    restartUnit = static_cast<long long>(options.restartBase) * std::max(1, cellCount / 64);
+}
+
+/**
+ * @brief Luby 重启序列：1, 1, 2, 1, 1, 2, 4, 1, 1, 2, ...
+ * @param index 序号（从 1 开始）。
+ * @return 该项的值。
+ */
+int WFCGenerator::lubyTerm(int index) {
+    for (int k = 1; k < 31; ++k) {
+        int length = (1 << k) - 1;
+        if (index == length) return 1 << (k - 1);
+        if (index < length) return lubyTerm(index - (1 << (k - 1)) + 1);
+    }
+    return 1 << 30;
+}
+
+/**
+ * @brief 在搜索范围内执行坍缩/传播/回溯循环。
+ * 不断选择熵最低的单元格，将其坍缩并传播，直到范围内所有单元格都坍缩或无法找到解。
+ * @param ctx 搜索上下文。
+ * @param allowDecomposition 是否允许把剩余区域分解为独立子问题。
+ * @return 如果范围内所有单元格都成功坍缩，返回 true。
+ */
+bool WFCGenerator::runSearch(SearchContext& ctx, bool allowDecomposition) {
+    int totalCells = ctx.region.empty() ? width * height : static_cast<int>(ctx.region.size());
+    int checkInterval = options.componentCheckInterval > 0 ? options.componentCheckInterval : std::max(width, height);
+    int nextComponentCheck = ctx.collapsedCount + checkInterval;
+
+    // 根搜索开始时按熵分段；此后随每次修改和撤销增量维护
+    if (&ctx == &state->root) {
+        buildEntropyBuckets();
+    }
+    bool batchActive = options.batchCollapse && options.batchSize >= 2 && options.cellSelection == CellSelection::MinEntropy;
+
+    while (ctx.collapsedCount < totalCells)
+    {
+        // 0. 批量坍缩：一次坍缩多个互不相邻的低熵单元格并一起传播，成功时跳过单步坍缩
+        bool batched = batchActive && &ctx == &state->root && collapseBatch(ctx);
+        if (!batched) {
+            // 1. 按选择策略选择单元格（默认熵最低）
+            int targetIndex = selectCell(ctx);
+            if (targetIndex < 0) {
+                std::cout << "Error: No valid cell to collapse, but not all cells are collapsed." << std::endl;
+                if (!backtrack(ctx)) { // 无法选择单元格，尝试回溯
+                    std::cout << "Backtrack failed. No solution found." << std::endl;
+                    return false;
+                }
+                continue;
+            }
+
+            // 2. 坍缩单元格
+            int chosenModule = -1;
+            if (!collapseCell(ctx, targetIndex, chosenModule)) {
+                int x, y;
+                layout.coordinatesOf(targetIndex, x, y);
+                std::cout << "Collapse failed at (" << x << ", " << y << "), likely due to global constraints. Backtracking..." << std::endl;
+                if (!backtrack(ctx)) {
+                    std::cout << "Backtrack failed. No solution found." << std::endl;
+                    return false;
+                }
+                continue;
+            }
+
+            // 保存当前状态以备可能的回溯
+            saveState(ctx, targetIndex, chosenModule);
+
+            // 更新单元格状态
+            assignModule(ctx, targetIndex, chosenModule);
+            ctx.lastCollapsed = targetIndex;
+
+            // 3. 传播约束（根搜索可选单例弧相容前瞻）；根搜索启用冲突学习时回跳到导致矛盾的决策，并按 Luby 序列重启
+            bool lookaheadActive = options.lookahead && &ctx == &state->root;
+            if (!propagate(ctx, targetIndex) || (lookaheadActive && !lookahead(ctx, targetIndex))) {
+                if (options.cellSelection == CellSelection::DomOverWDeg) {
+                    bumpConflictWeights(ctx);
+                }
+                std::cout << "Propagation led to a contradiction. Backtracking..." << std::endl;
+                if (!(isLearning(ctx) ? resolveConflict(ctx) : backtrack(ctx))) {
+                    std::cout << "Backtrack failed. No solution found." << std::endl;
+                    return false;
+                }
+                if (isLearning(ctx) && restartUnit > 0 && conflictsSinceRestart >= lubyTerm(stats.restarts + 1) * restartUnit) {
+                    if (!restart(ctx)) {
+                        std::cout << "Restart failed. No solution found." << std::endl;
+                        return false;
+                    }
+                    nextComponentCheck = ctx.collapsedCount + checkInterval;
+                }
+                continue;
+            }
+        }
+
+        // 4. 定期检测剩余区域是否已被隔开为互不影响的连通区域
+        if (allowDecomposition && ctx.collapsedCount >= nextComponentCheck && ctx.collapsedCount < totalCells) {
+            nextComponentCheck = ctx.collapsedCount + checkInterval;
+            int result = solveComponents(ctx);
+            if (result > 0) {
+                return true; // 所有子问题都已求解
+            }
+            if (result < 0) {
+                // 某个区域在当前边界下无解，回溯主搜索中的决策
+                std::cout << "A component has no solution. Backtracking..." << std::endl;
+                if (!backtrack(ctx)) {
+                    std::cout << "Backtrack failed. No solution found." << std::endl;
+                    return false;
+                }
+            }
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief 把未坍缩的单元格分解为连通区域，并作为独立子问题求解。
+ * 区域之间只隔着已坍缩的单元格，传播不会越过它们，因此各区域可以在各自的搜索上下文中
+ * 同时求解，互不加锁；较大的区域交给独立线程。任何区域无解时，撤销所有区域的修改。
+ * @param ctx 发起分解的搜索上下文。
+ * @return 1 表示所有区域都已求解；0 表示只有一个区域，未分解；-1 表示有区域无解。
+ */
+int WFCGenerator::solveComponents(SearchContext& ctx) {
+    SolverState& s = *state;
+    int cellCount = width * height;
+
+    // 1. 用广度优先搜索标记未坍缩单元格的连通区域
+    std::fill(s.componentLabels.begin(), s.componentLabels.end(), -1);
+    s.componentCells.clear();
+    s.componentStarts.clear();
+    for (int start = 0; start < cellCount; ++start) {
+        if (results.isSet(start) || s.componentLabels[start] >= 0) continue;
+        int label = static_cast<int>(s.componentStarts.size());
+        s.componentStarts.push_back(static_cast<int>(s.componentCells.size()));
+        s.componentLabels[start] = label;
+        s.componentCells.push_back(start);
+        for (size_t head = s.componentStarts.back(); head < s.componentCells.size(); ++head) {
+            int current = s.componentCells[head];
+            for (int i = 0; i < COUNT; ++i) {
+                int neighbor = layout.neighbor(current, i);
+                if (neighbor < 0 || results.isSet(neighbor) || s.componentLabels[neighbor] >= 0) continue;
+                s.componentLabels[neighbor] = label;
+                s.componentCells.push_back(neighbor);
+            }
+        }
+    }
+    int componentCount = static_cast<int>(s.componentStarts.size());
+    if (componentCount < 2) {
+        return 0;
+    }
+    s.componentStarts.push_back(static_cast<int>(s.componentCells.size()));
+
+    // 子搜索不进行冲突学习：除最大区域外都只是零星的小区域时，分解得不到并行收益，
+    // 反而让几乎整个剩余网格失去学习，此时继续在根搜索中求解
+    if (isLearning(ctx)) {
+        int largest = 0;
+        for (int i = 0; i < componentCount; ++i) {
+            largest = std::max(largest, s.componentStarts[i + 1] - s.componentStarts[i]);
+        }
+        if (static_cast<int>(s.componentCells.size()) - largest < options.minParallelCells) {
+            return 0;
+        }
+    }
+    std::cout << "Decomposed remaining cells into " << componentCount << " independent components." << std::endl;
+
+    // 2. 为每个区域建立独立的搜索上下文；子搜索在线程中运行，因此使用各自的内存池
+    struct ComponentSearch {
+        std::pmr::monotonic_buffer_resource resource;
+        SearchContext context;
+        std::mt19937 rng;
+        bool solved = false;
+        ComponentSearch() : context(&resource) {}
+    };
+    std::vector<std::unique_ptr<ComponentSearch>> searches;
+    searches.reserve(componentCount);
+    for (int k = 0; k < componentCount; ++k) {
+        auto search = std::make_unique<ComponentSearch>();
+        size_t size = static_cast<size_t>(s.componentStarts[k + 1] - s.componentStarts[k]);
+        prepareContext(search->context, size, size * 2);
+        search->context.region.assign(s.componentCells.begin() + s.componentStarts[k], s.componentCells.begin() + s.componentStarts[k + 1]);
+        search->context.component = k;
+        if (usesSelectionOrder()) {
+            std::sort(search->context.region.begin(), search->context.region.end(),
+                [this](int a, int b) { return selectionRank[a] < selectionRank[b]; });
+        }
+        search->rng.seed((*ctx.rng)());
+        search->context.rng = &search->rng;
+        searches.push_back(std::move(search));
+    }
+
+    // 3. 求解各区域：较大的区域并行，较小的区域在当前线程中依次求解
+    if (options.parallelComponents) {
+        materializeAllDomainChunks();
+    }
+    std::vector<std::future<bool>> futures(componentCount);
+    for (int k = 0; k < componentCount; ++k) {
+        SearchContext& sub = searches[k]->context;
+        if (options.parallelComponents && static_cast<int>(sub.region.size()) >= options.minParallelCells) {
+            futures[k] = std::async(std::launch::async, [this, &sub]() { return runSearch(sub, false); });
+        }
+    }
+    bool allSolved = true;
+    for (int k = 0; k < componentCount; ++k) {
+        searches[k]->solved = futures[k].valid() ? futures[k].get() : runSearch(searches[k]->context, false);
+        allSolved = allSolved && searches[k]->solved;
+    }
+
+    // 4. 全部成功则合并计数；否则撤销所有区域的修改，交给上层回溯
+    for (auto& search : searches) {
+        if (allSolved) {
+            for (int m = 0; m < moduleCount; ++m) ctx.moduleCounts[m] += search->context.moduleCounts[m];
+        }
+        else {
+            undoTrail(search->context, 0);
+        }
+    }
+    return allSolved ? 1 : -1;
+}
+
+/**
+ * @brief 主生成循环。
+ * 在整个网格上运行搜索；启用分解策略且没有全局上限时，剩余区域被隔开后会分别求解。
+ * @return 如果成功生成完整网格，返回 true。
+ */
+bool WFCGenerator::generate() {
+    // 结果网格每格最多两个字节，更多的模块无法表示
+    int valueCount = std::max(moduleCount, memberCount);
+    if (valueCount > PackedResultGrid::MaxValueCount) {
+        std::cout << "Error: Too many modules (" << valueCount << ") for the packed result grid, at most "
+                  << PackedResultGrid::MaxValueCount << " are supported." << std::endl;
+        return false;
+    }
+    // 经过 reset() 的生成器已经建好了运行状态，否则在这里初始化
+    if (!stateReady) {
+        initializeGrid();
+    }
+    stateReady = false;
+    applyGlobalLimits();
+    SolverState& s = *state;
+    auto startTime = std::chrono::steady_clock::now();
+
+    // 统计信息按次重置；缓存内容保留，是否使用在每次生成时重新判断
+    stats = WFCStats();
+    supportCacheActive = options.supportCache && !interning;
+    categoryStage = options.categoryPropagation && ruleset->hasCategories() && !interning;
+    learning = options.learnNogoods;
+    if (options.reachabilityRadius < 2) {
+        reachability.reset();
+    }
+    else if (!reachability || reachability->getRadius() != options.reachabilityRadius) {
+        reachability = ReachabilityTable::compute(*ruleset, options.reachabilityRadius);
+    }
+    if (options.batchCollapse) {
+        batchMarks.assign(static_cast<size_t>(width) * height, 0);
+        batchStamp = 0;
+        batchLimit = options.batchSize;
+    }
+    if (usesSelectionOrder() && (selectionOrder.size() != static_cast<size_t>(width) * height || selectionOrderPolicy != options.cellSelection)) {
+        buildSelectionOrder();
+    }
+    if (options.cellSelection == CellSelection::DomOverWDeg) {
+        edgeWeights.assign(static_cast<size_t>(width) * height * COUNT, 1.0);
+        weightIncrement = 1.0;
+    }
+    beliefCell = -1;
+    if (learning) {
+        resetNogoods();
+    }
+    if (supportCacheActive && supportCacheDirs.empty()) {
+        supportCacheKeys.assign(static_cast<size_t>(supportCacheSlots) * wordsPerDomain, 0);
+        supportCacheMasks.assign(static_cast<size_t>(supportCacheSlots) * wordsPerDomain, 0);
+        supportCacheDirs.assign(supportCacheSlots, -1);
+    }
+
+    bool success = true;
+    bool sampled = options.exactStrips && std::min(width, height) <= options.stripMaxWidth && !hasGlobalLimits()
+                   && sampleStrip(success);
+    if (!sampled) {
+        if (options.initialArcConsistency && !applyInitialArcConsistency()) {
+            std::cout << "Initial arc consistency pass found no solution." << std::endl;
+            success = false;
+        }
+        if (success) {
+            success = runSearch(s.root, options.decomposeComponents && !hasGlobalLimits());
+        }
+    }
+
+    // 压缩规则集在求解完成后把等价类展开为具体模块
+    if (ruleset->isCompressed() && success) {
+        expandEquivalenceClasses();
+    }
+    materializeCells();
+
+    // 汇总各模块的计数
+    globalModuleCounts.clear();
+    if (ruleset->isCompressed() && success) {
+        const Ruleset& original = *ruleset->getParent();
+        for (int m = 0; m < original.getModuleCount(); ++m) {
+            if (s.memberCounts[m] > 0) globalModuleCounts[original.getModule(m).id] = s.memberCounts[m];
+        }
+    }
+    else {
+        for (int m = 0; m < moduleCount; ++m) {
+            if (s.root.moduleCounts[m] > 0) globalModuleCounts[ruleset->getModule(m).id] = s.root.moduleCounts[m];
+        }
+    }
+    trailReserve = std::max(trailReserve, s.root.trail.capacity());
+    if (learning) {
+        nogoodReserve = std::max(nogoodReserve, std::max(s.nogoodStarts.size(), s.unitNogoods.size()));
+        reasonReserve = std::max(reasonReserve, s.reasonPool.capacity());
     }
+    domainChunkReserve = std::max(domainChunkReserve, s.materializedChunks);
+    stats.elapsedMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startTime).count();
 
-    // ǷеԪѳɹ̮
-    if (collapsedCount == width * height) {
+    // 检查是否所有单元格都已成功坍缩
+    if (success) {
         std::cout << "WFC generation successful!" << std::endl;
         return true;
     }
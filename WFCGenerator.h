@@ -7,220 +7,612 @@
 #include <algorithm>
 #include <random>
 #include <chrono>
-#include <stack>
-#include <SFML/System/Vector2.hpp>
+#include <memory>
+#include <memory_resource>
+#include <optional>
+#include <cstddef>
+#include <cstdint>
+#include "Ruleset.h"
+#include "GridLayout.h"
+#include "PackedResultGrid.h"
+#include "DomainInterner.h"
+#include "ReachabilityTable.h"
+#include "WFCStripSampler.h"
 
-/**
- * @brief ĸ
- * COUNT ڻȡ
- */
-enum Direction {
-    TOP,    // 
-    BOTTOM, // 
-    LEFT,   // 
-    RIGHT,  // 
-    COUNT   // 
-};
-
-// 
-std::string directionToString(Direction dir);
+class BitPlaneGrid;
 
 /**
- * @class Module
- * @brief һɵԪƬ
- * ÿģ鶼صIDȨءڽӹƬϵλá
+ * @class Cell
+ * @brief 代表输出网格中的一个单元格。
+ * 单元格只保存坐标和坍缩结果，是生成结束后根据紧凑结果网格建立的视图；
+ * 求解过程中的可能模块集合和坍缩状态都由生成器统一维护。
  */
-class Module {
+class Cell {
 public:
-    std::string id;                                     // ģΨһʶ
-    double weight;                                      // ģѡʱȨأӰƵ
-    std::map<Direction, std::set<std::string>> adjacencyRules; // ڽӹ򣬶ڸϿЩģID
-    sf::Vector2i tileIndex;                             // ģƬtilesetϵ
+    int x, y;                               // 单元格在网格中的坐标
+    bool isCollapsed;                       // 标记单元格是否已坍缩
+    const Module* module = nullptr;         // 指向坍缩后选定的模块对象的指针
 
     /**
-     * @brief Module 캯
-     * @param id ģID
-     * @param weight ģȨء
+     * @brief Cell 构造函数。
+     * @param x X坐标。
+     * @param y Y坐标。
      */
-    Module(std::string id, double weight) : id(id), weight(weight), tileIndex(0, 0) {}
+    Cell(int x, int y) : x(x), y(y), isCollapsed(false) {}
+};
 
-    /**
-     * @brief 鵱ǰģǷָһģݡ
-     * ˫ģAϷܽBͬʱB·ҲܽA
-     * @param dir ڵǰģķ
-     * @param otherModule ҪԵһģ顣
-     * @return 򷵻 true򷵻 false
-     */
-    bool isCompatible(Direction dir, const Module& otherModule) const {
-        Direction oppositeDir;
-        if (dir == TOP) oppositeDir = BOTTOM;
-        else if (dir == BOTTOM) oppositeDir = TOP;
-        else if (dir == LEFT) oppositeDir = RIGHT;
-        else oppositeDir = LEFT;
+/**
+ * @struct TrailEntry
+ * @brief 回溯轨迹中的一条记录。
+ * 传播时每移除一个可能模块、每坍缩一个单元格都会追加一条记录，回溯时按逆序撤销。
+ */
+struct TrailEntry {
+    int cellIndex;      // 被修改单元格的扁平索引（y * width + x）
+    int moduleIndex;    // 被移除或被选中的模块索引
+    bool isCollapse;    // true 表示坍缩记录，false 表示移除记录
+    int reason = -1;    // 移除原因：>= 0 为导致移除的邻居单元格，-1 为坍缩本身，<= -2 为原因池中的决策集合（偏移 -2 - reason）
+};
 
-        // ˫Ƿ񶼶˶ӦĹ
-        if (adjacencyRules.count(dir) == 0 || otherModule.adjacencyRules.count(oppositeDir) == 0) {
-            return false;
-        }
+/**
+ * @struct NogoodLiteral
+ * @brief 冲突学习中的一个决策：单元格坍缩为某个模块。
+ */
+struct NogoodLiteral {
+    int cellIndex;      // 单元格索引
+    int moduleIndex;    // 模块索引
+};
 
-        // Ƿ໥ƥ
-        return adjacencyRules.at(dir).count(otherModule.id) &&
-            otherModule.adjacencyRules.at(oppositeDir).count(this->id);
-    }
+/**
+ * @struct StateSnapshot
+ * @brief 回溯点。
+ * 当选择一个模块进行坍缩时，记录该决策以及决策前的轨迹长度。如果后续生成失败，
+ * 只需把轨迹撤销到该长度即可恢复网格和全局计数，无需复制整个网格。
+ */
+struct StateSnapshot {
+    int cellIndex;          // 发生坍缩的单元格索引
+    int attemptedModule;    // 尝试坍缩成的模块索引
+    size_t trailMark;       // 坍缩前的轨迹长度
+    bool batched = false;   // 与前一个决策同批坍缩：保存时前面的同批决策尚未传播
 };
 
 /**
- * @class Cell
- * @brief еһԪ
- * ÿԪάһܵģ飬ֱ̮Ϊһȷģ顣
+ * @enum CellSelection
+ * @brief 选择下一个坍缩单元格的策略。
  */
-class Cell {
-public:
-    int x, y;                               // Ԫе
-    bool isCollapsed;                       // ǵԪǷ̮
-    std::set<std::string> possibleModules;  // 洢ǰԪпܵģID
-    std::string chosenModuleId;             // ̮ѡģID
-    const Module* module = nullptr;         // ָ̮ѡģָ
+enum class CellSelection {
+    MinEntropy,     // 可能模块最少（熵最低）的单元格
+    DomOverWDeg,    // 可能模块数除以冲突加权度最小的单元格
+    NearestToLast,  // 离上一次坍缩最近的未坍缩单元格，同距离时取熵最低
+    Scanline,       // 按行扫描顺序的第一个未坍缩单元格
+    Spiral,         // 从网格中心向外螺旋顺序的第一个未坍缩单元格
+    EntropyNearest, // 熵最低，并列时取离上一次坍缩最近的单元格
+    BeliefMarginal  // 上一次坍缩附近的窗口内，信念传播边缘分布最集中的单元格
+};
 
+/**
+ * @struct WFCOptions
+ * @brief 生成器的可选求解策略。
+ */
+struct WFCOptions {
+    // 独立子问题分解：已坍缩的单元格把剩余区域隔开后，各连通区域之间不再通过邻接规则相互影响，
+    // 可以作为独立的子搜索求解，回溯只在区域内部进行。存在全局数量上限时各区域仍相互关联，此时不分解。
+    bool decomposeComponents = false;   // 是否启用独立子问题分解
+    bool parallelComponents = true;     // 是否并行求解各子问题
+    int minParallelCells = 64;          // 单元格数达到该值的子问题才交给独立线程
+    int componentCheckInterval = 0;     // 每坍缩多少个单元格检测一次连通区域，0 表示取网格的较长边
 
-    /**
-     * @brief Cell 캯
-     * @param x Xꡣ
-     * @param y Yꡣ
-     * @param allModules пģбڳʼ possibleModules
-     */
-    Cell(int x, int y, const std::vector<Module>& allModules) : x(x), y(y), isCollapsed(false) {
-        for (const auto& module : allModules) {
-            possibleModules.insert(module.id);
-        }
-    }
+    // 初始弧相容：搜索开始前用按模块切片的位平面对整个网格做一次弧相容处理，
+    // 并批量禁用数量上限为 0 的模块。
+    bool initialArcConsistency = true;  // 是否在搜索前进行整体弧相容处理
 
-    /**
-     * @brief 㵥Ԫء
-     * WFCУͨǿģԽͣȷԽС
-     * @return ģ
-     */
-    size_t calculateEntropy() const {
-        return possibleModules.size();
-    }
+    // 多步可达传播：每次坍缩后，按规则集离线算出的距离 2 到 reachabilityRadius 的可达掩码，
+    // 直接移除这些偏移处不可能出现的模块，并从被修改的单元格继续传播。每次坍缩的开销固定为
+    // 偏移数 × 字数，能比只看相邻单元格更早暴露矛盾。0 或 1 表示不启用。
+    int reachabilityRadius = 0;         // 可达掩码的最大曼哈顿距离
 
-    /**
-     * @brief ӿģ鼯ƳһģID
-     * WFC׶εĺĲ
-     * @param moduleId ҪƳģID
-     * @return ɹƳģ飬򷵻 true
-     */
-    bool removePossibleModule(const std::string& moduleId) {
-        if (possibleModules.count(moduleId)) {
-            possibleModules.erase(moduleId);
-            return true;
-        }
-        return false;
-    }
+    // 单元格存储顺序：超大网格上分块或 Z 序排列能让纵向邻居落在相近的内存中。
+    CellLayout cellLayout = CellLayout::RowMajor; // 单元格排列方式
+    int layoutTileSize = 8;             // 分块边长（2 的幂），宽高需为其整数倍
 
-    /**
-     * @brief õԪ״̬
-     * ڻʱԪָ֮ǰĳ״̬
-     * @param initialPossibleModules ҪָĿģ鼯ϡ
-     */
-    void reset(const std::set<std::string>& initialPossibleModules) {
-        isCollapsed = false;
-        chosenModuleId = "";
-        possibleModules = initialPossibleModules;
-    }
+    // 无界面模式：不创建 Cell 对象，getGrid() 中全部为空指针，结果只能通过 getResult()/getModuleIndex() 读取。
+    // 超大地图上 Cell 对象和网格指针占用的内存远多于紧凑结果本身。
+    bool headless = false;              // 是否跳过 Cell 对象的创建
+
+    // 集合合并存储：相同的可能模块集合只保存一份，每个单元格只保存一个句柄，传播中的并集和交集通过记忆表查得。
+    // 适合模块较多但单元格集合种类很少的规则集；并行分解时不使用。出现新集合时合并表会扩容，不保证循环内零分配。
+    bool internDomains = false;         // 是否使用集合合并存储
+
+    // 支持并集缓存：传播时按 (可能模块集合, 方向) 缓存邻居允许的模块并集。
+    // 预热阶段命中率低于阈值时，本次生成的剩余部分自动绕过缓存。
+    bool supportCache = true;           // 是否启用支持并集缓存
+    double supportCacheMinHitRate = 0.5; // 预热结束时要求的最低命中率
+
+    // 类别级传播：模块带有 class 标签时，可能模块跨多个类别的单元格只按类别兼容关系约束邻居，
+    // 只剩一个类别的单元格才在类别内部按模块细化。可能模块较少的单元格按模块求并集本身就很便宜，
+    // 而且类别级约束较弱，因此仍直接按模块传播。合并存储时不使用。
+    bool categoryPropagation = true;    // 是否启用类别级传播
+    int categoryMinDomain = 64;         // 可能模块达到该数量的单元格才按类别传播
+
+    // 冲突学习：传播出现矛盾时沿轨迹中的移除原因求出导致矛盾的决策集合（nogood），直接回跳到其中最晚的决策；
+    // 较小的集合被保存下来，之后每次坍缩按双观察文字检查，只差一个决策就成立时提前移除该决策。
+    // 学到的集合在一次生成内跨重启保留。只用于根搜索。
+    // 重启要重新坍缩整个网格，因此重启间隔按网格大小放大：每 64 个单元格乘一次 restartBase。
+    bool learnNogoods = true;           // 是否启用冲突学习和回跳
+    int maxNogoodSize = 8;              // 保存的 nogood 最多包含的决策数量
+    int maxNogoods = 100000;            // 一次生成最多保存的 nogood 数量
+    int restartBase = 64;               // 重启间隔的基数（Luby 序列的每一项对应的冲突次数），0 表示不重启
+
+    // 单例弧相容前瞻：每次坍缩并传播后，对附近（经未坍缩单元格相连、距离不超过 lookaheadRadius）的单元格
+    // 逐个试探其可能模块：在轨迹上临时坍缩并传播，导致矛盾的模块直接移除，随后撤销试探。
+    // 某个单元格的模块全部被移除时，本次坍缩立即按矛盾处理，而不必等到几步之后才暴露。只用于根搜索。
+    bool lookahead = false;             // 是否启用单例弧相容前瞻
+    int lookaheadRadius = 2;            // 试探范围（按邻接步数）
+    int lookaheadBudget = 32;           // 每次坍缩最多试探的模块数量
+
+    // 单元格选择：DomOverWDeg 为每条相邻关系保存冲突权重，根搜索每次出现矛盾时增加使单元格变空的那条相邻关系的权重。
+    // 每次增加后增量按衰减系数放大，相当于旧权重逐渐衰减。单元格的加权度是它与未坍缩邻居之间相邻关系的权重之和。
+    // 该策略每一步都要扫描整个搜索范围。
+    // 局部性顺序：扫描线和螺旋按预先排好的顺序用游标选择，撤销坍缩时游标回退，均摊 O(1)；
+    // NearestToLast 从上一次坍缩处按曼哈顿距离逐圈查找，超过 nearestSearchRadius 仍未找到时退回扫描线顺序；
+    // EntropyNearest 在最低熵的单元格中同样逐圈查找，附近没有时随机选择。
+    // 这些顺序让坍缩集中在一片连续区域内推进，访问的内存相近，也较少留下互相孤立、之后才相遇的局部区域。
+    CellSelection cellSelection = CellSelection::MinEntropy; // 单元格选择策略
+    double conflictWeightDecay = 0.95;  // 冲突权重的衰减系数
+    int nearestSearchRadius = 8;        // 逐圈查找的最大距离
+
+    // 信念传播选择（BeliefMarginal）：以上一次坍缩为中心、边长 2 * beliefWindow + 1 的方形窗口内，
+    // 在未坍缩单元格和邻接约束组成的因子图上做 beliefIterations 轮循环信念传播（窗口外视为已由可能模块集合约束）。
+    // 选择边缘分布最大概率最高的单元格，并按边缘分布而不是模块权重抽样坍缩；窗口内没有未坍缩单元格时按熵选择。
+    // 每一步的开销约为 窗口单元格数 × 4 × 轮数 × 可能模块数 × 兼容行长度。只用于根搜索，子问题按熵选择。
+    int beliefWindow = 3;               // 窗口半径
+    int beliefIterations = 4;           // 信念传播轮数
+
+    // 最少约束值：坍缩时统计每个候选模块会保留多少邻居可能模块（由编译后的兼容行按位求得），
+    // 把权重乘以保留比例的 lcvBias 次方，使抽样偏向约束较少的模块。lcvBias 越大偏向越强。
+    bool leastConstrainingValue = false; // 是否按约束程度调整坍缩权重
+    double lcvBias = 1.0;               // 偏向强度
+
+    // 批量坍缩：根搜索按熵选择单元格时，每一步从最低熵的段中选出一批两两距离大于 2（没有公共邻居）的单元格，
+    // 全部坍缩后从它们一起传播一次，分摊每一步的选择和传播开销。一起传播失败时撤销整批，
+    // 批量上限减半并改走单步坍缩；成功时上限加倍。
+    bool batchCollapse = false;         // 是否启用批量坍缩
+    int batchSize = 16;                 // 一批最多坍缩的单元格数量
+
+    // 长条精确采样：较短的边不超过 stripMaxWidth 且没有限制整个模块（压缩规则集中为整个等价类）的全局上限时，
+    // generate() 改用 WFCStripSampler 逐行精确采样，不回溯，每行耗时固定，结果服从按模块权重乘积加权的
+    // 全部合法地图的分布（与逐格坍缩的分布不同）。等价类中只有部分成员受上限约束时，采样结果与搜索结果一样
+    // 在展开等价类时遵守成员上限，受限成员被同类的其他成员替换，此时分布不再精确。
+    // 行状态数量超出采样器上限时退回普通搜索。
+    bool exactStrips = false;           // 是否对窄长条地图使用精确采样
+    int stripMaxWidth = 12;             // 使用精确采样的最大较短边长
 };
 
 /**
- * @struct StateSnapshot
- * @brief ڻʱͻָ㷨Ĺؼ״̬
- * ѡһģ̮ʱᴴһաʧܣʹô˿սлݡ
+ * @struct WFCStats
+ * @brief 一次生成的统计信息。
  */
-struct StateSnapshot {
-    int cellX, cellY;                                           // ̮ĵԪ
-    std::set<std::string> initialPossibleModules;               // ̮ǰõԪĿģ
-    std::string attemptedModuleId;                              // ̮ɵģID
-    std::map<std::pair<int, int>, std::set<std::string>> gridStateSnapshot; // ̮ǰ״̬
-    std::map<std::string, int> globalModuleCountsSnapshot;      // ȫģ̮ǰ״̬
+struct WFCStats {
+    double elapsedMs = 0.0;                 // 生成耗时（毫秒）
+    long long supportCacheHits = 0;         // 支持并集缓存命中次数
+    long long supportCacheMisses = 0;       // 支持并集缓存未命中次数
+    bool supportCacheBypassed = false;      // 命中率过低，缓存在本次生成的剩余部分被绕过
+    long long backtracks = 0;               // 根搜索撤销的决策次数（回溯和回跳）
+    long long conflicts = 0;                // 冲突学习分析过的矛盾次数
+    int learnedNogoods = 0;                 // 保存下来的 nogood 数量
+    long long nogoodPrunes = 0;             // nogood 提前移除的模块数量
+    int restarts = 0;                       // 重启次数
+    long long lookaheadProbes = 0;          // 前瞻试探的次数
+    long long lookaheadPrunes = 0;          // 前瞻移除的模块数量
+    long long batches = 0;                  // 成功的批量坍缩次数
+    long long batchedCells = 0;             // 批量坍缩的单元格总数
+    long long batchRollbacks = 0;           // 一起传播失败而撤销的批次
+    long long reachabilityPrunes = 0;       // 根搜索中可达掩码移除的模块数量
 
-    /**
-     * @brief StateSnapshot 캯
-     */
-    StateSnapshot(int x, int y, const std::set<std::string>& possible,
-        const std::string& attempted,
-        const std::map<std::pair<int, int>, std::set<std::string>>& currentGridState,
-        const std::map<std::string, int>& currentGlobalModuleCounts)
-        : cellX(x), cellY(y), initialPossibleModules(possible), attemptedModuleId(attempted),
-        gridStateSnapshot(currentGridState), globalModuleCountsSnapshot(currentGlobalModuleCounts) {
+    // 支持并集缓存的命中率，没有查询时为 0
+    double supportCacheHitRate() const {
+        long long total = supportCacheHits + supportCacheMisses;
+        return total > 0 ? static_cast<double>(supportCacheHits) / total : 0.0;
     }
 };
 
 /**
  * @class WFCGenerator
- * @brief ̮WFC㷨ĺʵࡣ
- * ģ顢ɹ̡ݵȡ
+ * @brief 波函数坍缩（WFC）算法的核心实现类。
+ * 管理网格、模块、生成过程、回溯等。
  */
 class WFCGenerator {
 public:
     /**
-     * @brief WFCGenerator 캯
-     * @param width Ŀȡ
-     * @param height ĸ߶ȡ
-     * @param modules ɵģб
+     * @brief WFCGenerator 构造函数。
+     * @param width 生成网格的宽度。
+     * @param height 生成网格的高度。
+     * @param ruleset 共享的只读规则集，多个生成器可以同时使用同一份。
+     */
+    WFCGenerator(int width, int height, std::shared_ptr<const Ruleset> ruleset);
+
+    /**
+     * @brief WFCGenerator 构造函数。
+     * 为模块列表单独编译一份规则集。
+     * @param width 生成网格的宽度。
+     * @param height 生成网格的高度。
+     * @param modules 用于生成的所有模块的列表。
      */
     WFCGenerator(int width, int height, const std::vector<Module>& modules);
 
     /**
-     * @brief WFCGenerator 
-     * ͷж̬ Cell 
+     * @brief WFCGenerator 析构函数。
+     * 先销毁运行状态，再释放其所在的内存池。
      */
     ~WFCGenerator();
 
     /**
-     * @brief ضģеޡ
-     * @param moduleId ҪƵģID
-     * @param limit ޡ
+     * @brief 设置特定模块在整个网格中的数量上限。
+     * @param moduleId 要限制的模块ID。
+     * @param limit 数量上限。
      */
     void setGlobalModuleLimit(const std::string& moduleId, int limit);
 
     /**
-     * @brief WFCɹ̡
-     * @return ɹ򷵻 true򷵻 false
+     * @brief 使用预先计算的可达掩码表，多个使用同一规则集的生成器可以共享一份。
+     * 表的半径与 WFCOptions::reachabilityRadius 不同时，generate() 会重新计算。
+     * @param table 由 ReachabilityTable::compute() 为本生成器的规则集计算的表。
+     */
+    void setReachabilityTable(std::shared_ptr<const ReachabilityTable> table);
+
+    /**
+     * @brief 启动WFC生成过程。
+     * @return 如果成功生成完整网格则返回 true，否则返回 false。
      */
     bool generate();
 
     /**
-     * @brief ȡɵݡ
-     * @return һãָ洢 Cell ָĶά
+     * @brief 获取生成的网格数据。
+     * @return 一个常量引用，指向存储 Cell 指针的二维向量。
      */
     const std::vector<std::vector<Cell*>>& getGrid() const;
 
+    /**
+     * @brief 获取紧凑的坍缩结果，按 getLayout() 的存储索引排列。
+     * 生成成功后其中是 getResultRuleset() 中的模块索引。
+     */
+    const PackedResultGrid& getResult() const { return results; }
+
+    /**
+     * @brief 获取结果中模块索引所对应的规则集：压缩规则集求解成功后为原始规则集，否则为生成器的规则集。
+     */
+    const Ruleset& getResultRuleset() const;
+
+    /**
+     * @brief 获取某个位置坍缩后的模块索引。
+     * @return getResultRuleset() 中的模块索引，未坍缩时返回 -1。
+     */
+    int getModuleIndex(int x, int y) const { return results.get(layout.indexOf(x, y)); }
+
+    /**
+     * @brief 获取某个位置坍缩后的模块。
+     * @return 模块指针，未坍缩时返回 nullptr。
+     */
+    const Module* getModuleAt(int x, int y) const;
+
     const std::map<std::string, int>& getGlobalModuleCounts() const;
 
     /**
-     * @brief ڿ̨ӡɵڵԣ
+     * @brief 获取上一次生成的统计信息。
+     */
+    const WFCStats& getStats() const { return stats; }
+
+    /**
+     * @brief 获取生成器使用的规则集。
+     * @return 共享的只读规则集。
+     */
+    const std::shared_ptr<const Ruleset>& getRuleset() const;
+
+    /**
+     * @brief 在控制台打印生成的网格（用于调试）。
      */
     void printGrid() const;
 
     /**
-     * @brief ɵӡ
-     * @param seed ӡ
+     * @brief 设置用于随机数生成的种子。
+     * @param seed 随机数种子。
      */
     void setSeed(unsigned int seed);
 
+    /**
+     * @brief 重置生成器以便复用。
+     * 重新设置种子并清除全局数量上限和上一次的结果，保留已编译的规则和内存池缓冲区，
+     * 并提前在原缓冲区中建好运行状态，随后的 generate() 不再需要任何准备工作。
+     * @param seed 随机数种子。
+     */
+    void reset(unsigned int seed);
+
+    /**
+     * @brief 设置求解策略。reset() 不会清除已设置的策略。
+     * @param options 求解策略。
+     */
+    void setOptions(const WFCOptions& options);
+
+    const WFCOptions& getOptions() const { return options; }
+
+    int getWidth() const { return width; }
+    int getHeight() const { return height; }
+
+    /**
+     * @brief 获取单元格坐标与内部存储索引之间的映射。
+     */
+    const GridLayout& getLayout() const { return layout; }
+
 private:
-    int width, height;                                  // ߴ
-    std::vector<std::vector<Cell*>> grid;               // 洢ԪĶά
-    std::vector<Module> allModules;                     // пģĸ
-    std::map<std::string, int> globalModuleCounts;      // ǰиģļ
-    std::map<std::string, int> globalModuleLimits;      // ģȫ
-    std::stack<StateSnapshot> stateStack;               // ڻݵ״̬ջ
-    std::mt19937 gen;                                   // 
-
-    // ˽и
-    void initializeGrid();                              // ʼ񣬴 Cell 
-    Cell* getLowestEntropyCell();                       // Ҳͣȷδ̮Ԫ
-    bool collapseCell(Cell* cell, std::string& chosenModuleId); // ̮һԪΪѡһȷģ
-    bool propagate(int startX, int startY);             // һ㿪ʼ⴫ԼھӵԪĿģ
-    void saveState(Cell* cellToCollapse, const std::string& chosenModuleId); // 浱ǰ״̬ջ
-    bool backtrack();                                   // ִлݣָһ״̬ѡ
+    /**
+     * @struct SearchContext
+     * @brief 一次回溯搜索自己的状态。
+     * 整个网格的搜索使用根上下文；分解出的独立子问题各自使用一个上下文，
+     * 拥有独立的轨迹、回溯点和随机数生成器，因此回溯只影响本区域。
+     */
+    struct SearchContext {
+        std::pmr::vector<TrailEntry> trail;             // 回溯轨迹
+        std::pmr::vector<StateSnapshot> decisions;      // 回溯点栈
+        std::pmr::vector<int> propagationStack;         // 传播工作栈
+        std::pmr::vector<int> candidateCells;           // 最低熵候选单元格
+        std::pmr::vector<int> candidateModules;         // 坍缩时的候选模块
+        std::pmr::vector<double> candidateWeights;      // 候选模块对应的权重
+        std::pmr::vector<uint64_t> supportMask;         // 传播时邻居可保留模块的并集
+        std::pmr::vector<int> moduleCounts;             // 本次搜索中各模块的计数（根上下文即全局计数）
+        std::pmr::vector<int> region;                   // 搜索范围内的单元格，为空表示整个网格
+        std::mt19937* rng = nullptr;                    // 本次搜索使用的随机数生成器
+        int collapsedCount = 0;                         // 本次搜索坍缩的单元格数量，随轨迹增减
+        int emptyCells = 0;                             // 可能模块为空的单元格数量，随轨迹增减
+        int conflictCell = -1;                          // 最近一个可能模块变为空的单元格
+        std::pmr::vector<int> pendingCells;             // 坍缩时被 nogood 移除了模块、等待传播的单元格
+        std::pmr::vector<int> lookaheadCells;           // 前瞻试探范围内的单元格
+        std::pmr::vector<int> batchCells;               // 批量坍缩中的一批单元格
+        int component = -1;                             // 子问题所属的连通区域编号，根搜索为 -1
+        int lastCollapsed = -1;                         // 最近一次决策坍缩的单元格
+        size_t orderCursor = 0;                         // 按固定顺序选择时，此前的单元格都已坍缩
+
+        // 是否出现矛盾（有单元格的可能模块为空）
+        bool hasContradiction() const { return emptyCells > 0; }
+
+        explicit SearchContext(std::pmr::memory_resource* resource)
+            : trail(resource), decisions(resource), propagationStack(resource), candidateCells(resource),
+            candidateModules(resource), candidateWeights(resource), supportMask(resource),
+            moduleCounts(resource), region(resource), pendingCells(resource), lookaheadCells(resource), batchCells(resource) {
+        }
+    };
+
+    /**
+     * @struct SolverState
+     * @brief 单次生成所需的全部运行状态。
+     * 所有容器都从生成器持有的单调内存池中分配，生成开始时一次性建好，结束时随内存池整体释放，
+     * 坍缩/传播循环内部不会再向系统堆申请内存。轨迹、nogood 和原因池按之前生成的峰值预留，
+     * 只有超过峰值的那次生成会在循环中扩容。
+     */
+    struct SolverState {
+        std::pmr::vector<Cell> cells;                   // 所有单元格，按存储索引排列；无界面模式下为空
+        std::pmr::vector<uint64_t*> domainChunks;       // 每块单元格的可能模块位集（宽存储每格 wordsPerDomain 个字，紧凑存储每格 domainBits 位），空指针表示整块仍是完整集合
+        std::pmr::vector<int*> sizeChunks;              // 每块单元格剩余的可能模块数量（即熵），与 domainChunks 同时建立
+        std::pmr::vector<uint64_t> fullDomain;          // 宽存储时的完整位集
+        std::pmr::vector<DomainInterner::Handle> domainHandles; // 合并存储时每个单元格的集合句柄
+        size_t materializedChunks = 0;                  // 已建立的位集块数量
+        std::pmr::vector<int> moduleLimits;             // 各模块的全局数量上限，-1 表示不限
+        std::pmr::vector<int> memberCounts;             // 压缩规则集：各具体模块的计数
+        std::pmr::vector<int> memberLimits;             // 压缩规则集：各具体模块的全局数量上限
+        std::pmr::vector<char> inPropagationStack;      // 标记单元格是否已在工作栈中，保证栈深不超过单元格数
+        std::pmr::vector<int> componentLabels;          // 连通区域检测：每个单元格所属的区域编号
+        std::pmr::vector<int> componentCells;           // 连通区域检测：按区域连续排列的单元格
+        std::pmr::vector<int> componentStarts;          // 连通区域检测：每个区域在 componentCells 中的起点
+        std::pmr::vector<int> entropyCells;             // 熵分段：根搜索的单元格按熵分段排列，已坍缩的单元格熵记为 0
+        std::pmr::vector<int> entropySlots;             // 熵分段：单元格在 entropyCells 中的位置
+        std::pmr::vector<int> entropyStarts;            // 熵分段：每个熵值的段起点，末尾多一个结束位置
+        std::pmr::vector<int> entropyKeys;              // 熵分段：单元格当前所在段的熵值
+        // 冲突学习：nogood 以决策集合保存，前两个文字是观察文字；原因池与轨迹同步增减
+        std::pmr::vector<NogoodLiteral> nogoodLiterals; // 所有 nogood 的文字，按 nogoodStarts 分段
+        std::pmr::vector<int> nogoodStarts;             // 每个 nogood 在 nogoodLiterals 中的起点，末尾多一个结束位置
+        std::pmr::vector<NogoodLiteral> unitNogoods;    // 只含一个决策的 nogood，重启后直接移除
+        std::pmr::vector<int> watchHeads;               // [单元格]：观察该单元格的第一个观察项，-1 表示没有
+        std::pmr::vector<int> watchNext;                // [nogood * 2 + k]：同一单元格上的下一个观察项，-1 表示结尾
+        std::pmr::vector<int> reasonPool;               // 移除原因：[数量, 单元格, 模块, ...]
+        std::pmr::vector<NogoodLiteral> conflictLiterals; // 冲突分析的结果
+        SearchContext root;                             // 整个网格的搜索上下文
+
+        explicit SolverState(std::pmr::memory_resource* resource)
+            : cells(resource), domainChunks(resource), sizeChunks(resource), fullDomain(resource), domainHandles(resource), moduleLimits(resource),
+            memberCounts(resource), memberLimits(resource), inPropagationStack(resource),
+            componentLabels(resource), componentCells(resource), componentStarts(resource),
+            entropyCells(resource), entropySlots(resource), entropyStarts(resource), entropyKeys(resource),
+            nogoodLiterals(resource), nogoodStarts(resource), unitNogoods(resource), watchHeads(resource), watchNext(resource),
+            reasonPool(resource), conflictLiterals(resource), root(resource) {
+        }
+    };
+
+    int width, height;                                  // 网格尺寸
+    GridLayout layout;                                  // 单元格坐标到存储索引的映射
+    std::vector<std::vector<Cell*>> grid;               // 存储网格单元格指针的二维向量
+    std::shared_ptr<const Ruleset> ruleset;             // 共享的只读规则集，Cell::module 指向其中的模块（压缩规则集展开后指向原始规则集）
+    std::map<std::string, int> globalModuleCounts;      // 生成结束后各模块的计数
+    std::map<std::string, int> globalModuleLimits;      // 各模块的全局数量上限
+    std::mt19937 gen;                                   // 随机数生成器
+    WFCOptions options;                                 // 求解策略
+
+    int moduleCount;                                    // 模块数量（缓存自规则集）
+    int wordsPerDomain;                                 // 每个位集占用的 64 位字数（缓存自规则集）
+    int memberCount;                                    // 压缩规则集对应的具体模块数量，未压缩时为 0
+    int domainBits = 0;                                 // 紧凑存储时每格可能模块位集的位数（2/4/8/16/32），0 表示宽存储
+    int domainShift = 0;                                // log2(domainBits)
+    uint64_t domainMask = 0;                            // 紧凑存储时一个单元格的位集掩码
+    uint64_t fullCellDomain = 0;                        // 紧凑存储时一个单元格的完整位集
+    static constexpr int domainChunkShift = 10;         // 每个位集块包含 2^domainChunkShift 个单元格
+    static constexpr int domainChunkMask = (1 << domainChunkShift) - 1;
+    size_t domainChunkReserve = 0;                      // 内存池为位集块预留的块数，按历史峰值增长
+    bool interning = false;                             // 本次生成是否使用集合合并存储
+    std::shared_ptr<const ReachabilityTable> reachability; // 多步可达掩码，启用时在 generate() 中按需计算
+    std::unique_ptr<DomainInterner> interner;           // 集合合并表，首次使用时创建，合并结果和记忆表在之后的生成中继续使用
+    std::unique_ptr<WFCStripSampler> stripSampler;      // 长条精确采样器，首次使用时创建，前缀树在之后的生成中继续使用
+    WFCStats stats;                                     // 上一次生成的统计信息
+
+    // 支持并集缓存：直接映射，键为 (位集, 方向)。规则集不可变，缓存内容在多次生成之间保持有效
+    static constexpr int supportCacheSlots = 4096;      // 缓存槽数量（2 的幂）
+    static constexpr long long supportCacheWarmup = 4096; // 判断命中率前的查询次数
+    std::vector<uint64_t> supportCacheKeys;             // [槽 * wordsPerDomain + w]：键位集
+    std::vector<uint64_t> supportCacheMasks;            // [槽 * wordsPerDomain + w]：支持并集
+    std::vector<signed char> supportCacheDirs;          // [槽]：键方向，-1 表示空槽
+    bool supportCacheActive = false;                    // 本次生成中缓存是否仍在使用
+    bool categoryStage = false;                         // 本次生成是否进行类别级传播
+    PackedResultGrid results;                           // 坍缩结果；求解过程中也用作单元格是否已坍缩的标记
+
+    // 冲突学习：nogood、观察列表和原因池位于 SolverState 中，这里只保存跨生成的预留容量和标记
+    bool learning = false;                              // 本次生成是否进行冲突学习
+    size_t nogoodReserve = 0;                           // 内存池为 nogood 预留的数量，按历史峰值增长
+    size_t reasonReserve = 0;                           // 原因池预留容量，按历史峰值增长
+    std::vector<int> conflictMarks;                     // 冲突分析：单元格的标记戳
+    std::vector<int> literalMarks;                      // 冲突分析：已加入集合的决策单元格的标记戳
+    int conflictStamp = 0;                              // 冲突分析的当前标记戳
+    long long conflictsSinceRestart = 0;                // 上次重启后的冲突次数
+    long long restartUnit = 0;                          // Luby 序列每一项对应的冲突次数，0 表示不重启
+
+    // dom/wdeg：每个单元格每个方向的冲突权重，相邻两个单元格的同一条相邻关系各存一份
+    std::vector<double> edgeWeights;
+    double weightIncrement = 1.0;                       // 下一次冲突增加的权重
+
+    // 信念传播选择：窗口内的未坍缩单元格、各方向传入的消息，以及被选单元格的边缘分布
+    std::vector<int> beliefCells;                       // 窗口内的未坍缩单元格
+    std::vector<int> beliefSlots;                       // 窗口位置到 beliefCells 下标的映射，-1 表示不在窗口内
+    std::vector<double> beliefMessages;                 // 传入消息，按 [窗口单元格][方向][模块] 排列
+    std::vector<double> beliefMarginal;                 // 被选单元格的边缘分布，按模块索引
+    int beliefCell = -1;                                // beliefMarginal 对应的单元格，collapseCell 据此抽样
+
+    // 固定选择顺序（扫描线或螺旋）：selectionOrder 按顺序列出单元格，selectionRank 是每个单元格在其中的位置
+    std::vector<int> selectionOrder;
+    std::vector<int> selectionRank;
+    CellSelection selectionOrderPolicy = CellSelection::MinEntropy; // selectionOrder 对应的策略
+
+    // 批量坍缩：选择时标记已选单元格附近的单元格；批量上限随成功和失败加倍或减半
+    std::vector<int> batchMarks;
+    int batchStamp = 0;
+    int batchLimit = 0;
+    bool resultsExpanded = false;                       // 结果是否已展开为原始规则集的模块索引
+
+    // 内存池：成员声明顺序保证析构时先销毁 state，再销毁内存池和缓冲区
+    std::vector<std::byte> arenaBuffer;                 // 内存池的初始缓冲区
+    std::unique_ptr<std::pmr::monotonic_buffer_resource> arena; // 单调内存池
+    size_t trailReserve = 0;                            // 轨迹预留容量，按历史峰值增长
+    std::optional<SolverState> state;                   // 当前生成的运行状态
+    std::unique_ptr<BitPlaneGrid> planeGrid;            // 初始弧相容使用的位平面，首次使用时创建并在之后复用
+    bool stateReady = false;                            // 运行状态是否已初始化且尚未被使用
+
+    // 可能模块位集的读写。位集按块惰性建立：尚未建立的块中所有单元格仍包含全部模块，
+    // 第一次从块中移除模块时才从内存池分配存储。紧凑存储时所有模块都在一个字中，w 只能为 0。
+    // 合并存储时单元格只保存集合句柄，读写都转换为合并表上的查找。
+    uint64_t domainWord(int cellIndex, int w) const {
+        if (interning) return interner->getWords(state->domainHandles[cellIndex])[w];
+        const uint64_t* chunk = state->domainChunks[cellIndex >> domainChunkShift];
+        size_t local = static_cast<size_t>(cellIndex & domainChunkMask);
+        if (domainBits) {
+            if (!chunk) return fullCellDomain;
+            size_t bit = local << domainShift;
+            return (chunk[bit >> 6] >> (bit & 63)) & domainMask;
+        }
+        return chunk ? chunk[local * wordsPerDomain + w] : state->fullDomain[w];
+    }
+    int domainSize(int cellIndex) const {
+        if (interning) return interner->getSize(state->domainHandles[cellIndex]);
+        const int* sizes = state->sizeChunks[cellIndex >> domainChunkShift];
+        return sizes ? sizes[cellIndex & domainChunkMask] : moduleCount;
+    }
+    bool hasDomainBit(int cellIndex, int module) const {
+        return (domainWord(cellIndex, module / 64) >> (module % 64)) & 1;
+    }
+    void removeDomainBit(int cellIndex, int module) {
+        if (interning) {
+            state->domainHandles[cellIndex] = interner->without(state->domainHandles[cellIndex], module);
+            return;
+        }
+        int chunkIndex = cellIndex >> domainChunkShift;
+        uint64_t* chunk = state->domainChunks[chunkIndex] ? state->domainChunks[chunkIndex] : materializeDomainChunk(chunkIndex);
+        size_t local = static_cast<size_t>(cellIndex & domainChunkMask);
+        if (domainBits) {
+            size_t bit = (local << domainShift) + module;
+            chunk[bit >> 6] &= ~(uint64_t(1) << (bit & 63));
+        }
+        else {
+            chunk[local * wordsPerDomain + module / 64] &= ~(uint64_t(1) << (module % 64));
+        }
+        state->sizeChunks[chunkIndex][local]--;
+    }
+    void restoreDomainBit(int cellIndex, int module) {
+        if (interning) {
+            state->domainHandles[cellIndex] = interner->with(state->domainHandles[cellIndex], module);
+            return;
+        }
+        // 被撤销的移除一定发生过，所在的块已经建立
+        int chunkIndex = cellIndex >> domainChunkShift;
+        uint64_t* chunk = state->domainChunks[chunkIndex];
+        size_t local = static_cast<size_t>(cellIndex & domainChunkMask);
+        if (domainBits) {
+            size_t bit = (local << domainShift) + module;
+            chunk[bit >> 6] |= uint64_t(1) << (bit & 63);
+        }
+        else {
+            chunk[local * wordsPerDomain + module / 64] |= uint64_t(1) << (module % 64);
+        }
+        state->sizeChunks[chunkIndex][local]++;
+    }
+
+    // 私有辅助函数
+    size_t estimateArenaBytes() const;                  // 估算一次生成所需的内存池大小
+    void initializeGrid();                              // 初始化运行状态
+    size_t domainChunkWords() const;                   // 一个位集块占用的 64 位字数
+    size_t domainChunkBytes() const;                    // 一个位集块（位集和熵）占用的字节数
+    uint64_t* materializeDomainChunk(int chunkIndex);   // 为一块单元格分配并填充完整的可能模块位集
+    void materializeAllDomainChunks();                  // 建立所有尚未建立的位集块
+    bool useInterning(const WFCOptions& options) const; // 是否使用集合合并存储
+    int selectDomainBits(const WFCOptions& options) const; // 根据模块数量和并行策略选择紧凑位集的位数
+    void materializeCells();                            // 根据紧凑结果建立 Cell 视图
+    void prepareContext(SearchContext& ctx, size_t cellCount, size_t trailCapacity); // 为搜索上下文预留容量
+    void applyGlobalLimits();                           // 把按ID设置的全局上限解析为按模块索引的上限
+    bool hasGlobalLimits() const;                       // 是否有任何模块受全局上限约束
+    bool applyInitialArcConsistency();                  // 用位平面对初始网格做整体弧相容处理
+    void expandEquivalenceClasses();                    // 把坍缩为等价类的单元格展开为具体模块
+    bool sampleStrip(bool& success);                    // 用长条精确采样器生成整张地图，采样器无法建立时返回 false
+    const uint64_t* supportUnion(SearchContext& ctx, int cellIndex, int dir); // 单元格可能模块在某方向上允许的邻居模块并集
+    const uint64_t* categorySupport(SearchContext& ctx, int cellIndex, int dir); // 跨多个类别的单元格在某方向上允许的类别成员并集
+    void removeModule(SearchContext& ctx, int cellIndex, int module, int reason); // 从单元格中移除一个模块并连同原因记录到轨迹
+    bool isLearning(const SearchContext& ctx) const { return learning && &ctx == &state->root; } // 该搜索是否进行冲突学习
+    int pushReason(const NogoodLiteral* literals, int count, int skipCell); // 把决策集合压入原因池，返回编码后的原因
+    int pushDecisionsReason(const SearchContext& ctx);  // 以全部现有决策作为原因
+    void analyzeConflict(SearchContext& ctx);           // 沿移除原因求出导致矛盾的决策集合
+    void learnNogood(const SearchContext& ctx, int latestLevel); // 保存冲突分析得到的 nogood
+    void checkNogoods(SearchContext& ctx, int cellIndex, int module); // 坍缩后检查观察该决策的 nogood
+    bool resolveConflict(SearchContext& ctx);           // 冲突学习并回跳
+    bool restart(SearchContext& ctx);                   // 撤销全部决策并重新应用单决策 nogood
+    void resetNogoods();                                // 清空上一次生成学到的 nogood
+    static int lubyTerm(int index);                     // Luby 重启序列的第 index 项（从 1 开始）
+    void undoTrail(SearchContext& ctx, size_t mark);    // 把轨迹撤销到指定长度
+    void buildEntropyBuckets();                         // 按当前熵建立根搜索的熵分段
+    void updateEntropyBucket(SearchContext& ctx, int cellIndex); // 根搜索中单元格的熵变化后把它移到对应的段
+    int selectCell(SearchContext& ctx);                 // 按选择策略返回下一个坍缩的单元格索引
+    int getLowestEntropyCell(SearchContext& ctx);       // 查找并返回熵最低（最不确定）的未坍缩单元格索引
+    int getDomWDegCell(SearchContext& ctx);             // 查找并返回可能模块数与冲突加权度之比最小的单元格索引
+    int getBeliefCell(SearchContext& ctx);              // 在窗口内做信念传播，返回边缘分布最集中的单元格索引
+    int getOrderedCell(SearchContext& ctx);             // 按固定顺序返回第一个未坍缩的单元格索引
+    int getNearestCell(SearchContext& ctx);             // 返回离上一次坍缩最近的未坍缩单元格索引
+    int findNearestCell(SearchContext& ctx, int requiredEntropy); // 在上一次坍缩附近逐圈查找未坍缩单元格
+    int pickCandidate(SearchContext& ctx) const;        // 从并列的候选单元格中选出一个
+    bool usesSelectionOrder() const;                    // 当前选择策略是否使用固定顺序
+    void buildSelectionOrder();                         // 按选择策略建立固定顺序
+    size_t orderPosition(const SearchContext& ctx, int cellIndex) const; // 单元格在搜索上下文的固定顺序中的位置
+    void bumpConflictWeights(SearchContext& ctx);       // 增加导致矛盾的相邻关系的冲突权重
+    bool collapseCell(SearchContext& ctx, int cellIndex, int& chosenModule); // 按权重和全局上限为单元格选择一个模块
+    int countRetained(int cellIndex, int module, int dir) const; // 单元格坍缩为某模块后该方向邻居保留的可能模块数量
+    void assignModule(SearchContext& ctx, int cellIndex, int module); // 把单元格坍缩为指定模块
+    bool propagate(SearchContext& ctx, int startIndex); // 从一个单元格开始，向外传播约束，更新邻居单元格的可能模块
+    void saveState(SearchContext& ctx, int cellIndex, int chosenModule); // 保存回溯点
+    bool backtrack(SearchContext& ctx);                 // 执行回溯，恢复到上一个状态并尝试其他选择
+    void pruneByReachability(SearchContext& ctx, int cellIndex, int module); // 按可达掩码移除远处单元格的模块
+    bool collapseBatch(SearchContext& ctx);             // 批量坍缩互不相邻的低熵单元格并一起传播
+    void requeueBatch(SearchContext& ctx, const StateSnapshot& undone); // 回退到批中间时重新传播前面的同批决策
+    bool probeModule(SearchContext& ctx, int cellIndex, int module); // 在轨迹上试探坍缩并传播，随后撤销
+    bool lookahead(SearchContext& ctx, int cellIndex);  // 对坍缩单元格附近的单元格做单例弧相容前瞻
+    bool runSearch(SearchContext& ctx, bool allowDecomposition); // 在搜索范围内执行完整的坍缩/传播/回溯循环
+    int solveComponents(SearchContext& ctx);            // 把未坍缩单元格分解为连通区域并分别求解
 };
\ No newline at end of file
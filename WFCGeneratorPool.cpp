@@ -0,0 +1,74 @@
+#include "WFCGeneratorPool.h"
+
+/**
+ * @brief 取出一个匹配的生成器，没有空闲的则新建一个。
+ * 选项在重置之前设置，上一个租借者的选项不会影响本次的运行状态；重置在锁外完成，避免阻塞其他线程。
+ */
+WFCGeneratorPool::Handle WFCGeneratorPool::acquire(const std::shared_ptr<const Ruleset>& ruleset, int width, int height, unsigned int seed,
+                                                   const WFCOptions& options) {
+    Key key(ruleset.get(), width, height);
+    std::unique_ptr<WFCGenerator> generator;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = idle.find(key);
+        if (it != idle.end() && !it->second.empty()) {
+            generator = std::move(it->second.back());
+            it->second.pop_back();
+        }
+    }
+    if (!generator) {
+        generator = std::make_unique<WFCGenerator>(width, height, ruleset);
+    }
+    generator->setOptions(options);
+    generator->reset(seed);
+    return Handle(generator.release(), [this, key](WFCGenerator* g) { release(key, g); });
+}
+
+/**
+ * @brief 预先创建生成器并放入池中。
+ * 新建的生成器会执行一次 reset()，以便提前分配好内存池缓冲区。
+ */
+void WFCGeneratorPool::prewarm(const std::shared_ptr<const Ruleset>& ruleset, int width, int height, size_t count,
+                                const WFCOptions& options) {
+    Key key(ruleset.get(), width, height);
+    size_t existing = 0;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        existing = idle[key].size();
+    }
+    for (size_t i = existing; i < count; ++i) {
+        auto generator = std::make_unique<WFCGenerator>(width, height, ruleset);
+        generator->setOptions(options);
+        generator->reset(0);
+        std::lock_guard<std::mutex> lock(mutex);
+        idle[key].push_back(std::move(generator));
+    }
+}
+
+/**
+ * @brief 销毁所有空闲的生成器。
+ */
+void WFCGeneratorPool::clear() {
+    std::lock_guard<std::mutex> lock(mutex);
+    idle.clear();
+}
+
+/**
+ * @brief 获取当前空闲的生成器数量。
+ */
+size_t WFCGeneratorPool::idleCount() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    size_t total = 0;
+    for (const auto& pair : idle) {
+        total += pair.second.size();
+    }
+    return total;
+}
+
+/**
+ * @brief 把生成器归还到对应规格的空闲列表中。
+ */
+void WFCGeneratorPool::release(const Key& key, WFCGenerator* generator) {
+    std::lock_guard<std::mutex> lock(mutex);
+    idle[key].push_back(std::unique_ptr<WFCGenerator>(generator));
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <map>
+#include <memory>
+#include <mutex>
+#include <functional>
+#include <tuple>
+#include <vector>
+#include "WFCGenerator.h"
+
+/**
+ * @class WFCGeneratorPool
+ * @brief 线程安全的生成器池。
+ * 按（规则集、宽度、高度）缓存已经创建好的生成器。连续生成同样规格的地图时，
+ * 直接取出空闲生成器并 reset()，跳过运行状态和内存池的分配。
+ * 租借者对生成器的设置（选项、种子、全局上限）不会传给下一个租借者：每次取出时都重新设置。
+ * 空闲生成器持有规则集的共享指针和整块内存池，规格不再使用时应调用 clear() 释放。
+ */
+class WFCGeneratorPool {
+public:
+    // 租借句柄：离开作用域时自动把生成器归还到池中，因此池的生命周期必须长于所有句柄
+    using Handle = std::unique_ptr<WFCGenerator, std::function<void(WFCGenerator*)>>;
+
+    /**
+     * @brief 取出一个匹配的生成器，没有空闲的则新建一个。
+     * 返回的生成器使用给定的选项，已用给定种子 reset()，全局数量上限为空；
+     * 上一个租借者设置的选项不会保留。
+     * @param ruleset 共享的只读规则集。
+     * @param width 网格宽度。
+     * @param height 网格高度。
+     * @param seed 随机数种子。
+     * @param options 求解策略，默认为 WFCOptions 的默认值。
+     * @return 生成器的租借句柄。
+     */
+    Handle acquire(const std::shared_ptr<const Ruleset>& ruleset, int width, int height, unsigned int seed,
+                   const WFCOptions& options = WFCOptions());
+
+    /**
+     * @brief 预先创建生成器并放入池中，使之后的 acquire() 不需要任何准备工作。
+     * @param ruleset 共享的只读规则集。
+     * @param width 网格宽度。
+     * @param height 网格高度。
+     * @param count 需要保持空闲的生成器数量。
+     * @param options 之后 acquire() 将使用的求解策略，内存池按它预先分配。
+     */
+    void prewarm(const std::shared_ptr<const Ruleset>& ruleset, int width, int height, size_t count,
+                 const WFCOptions& options = WFCOptions());
+
+    /**
+     * @brief 销毁所有空闲的生成器。
+     */
+    void clear();
+
+    /**
+     * @brief 获取当前空闲的生成器数量。
+     */
+    size_t idleCount() const;
+
+private:
+    using Key = std::tuple<const Ruleset*, int, int>;   // （规则集，宽度，高度）
+
+    mutable std::mutex mutex;                           // 保护 idle
+    std::map<Key, std::vector<std::unique_ptr<WFCGenerator>>> idle; // 各规格的空闲生成器
+
+    void release(const Key& key, WFCGenerator* generator); // 归还生成器
+};
@@ -0,0 +1,384 @@
+#include "WFCStripSampler.h"
+#include <iostream>
+#include <cmath>
+#include <algorithm>
+
+/**
+ * @brief WFCStripSampler 构造函数。
+ * 只确定行的方向，前缀树在 build() 中建立。
+ */
+WFCStripSampler::WFCStripSampler(int width, int height, std::shared_ptr<const Ruleset> ruleset, int maxStates)
+    : width(width), height(height), ruleset(std::move(ruleset)), maxStates(maxStates) {
+    moduleCount = this->ruleset->getModuleCount();
+    wordsPerDomain = this->ruleset->getWordsPerDomain();
+    if (width <= height) {
+        rowLength = width;
+        rowCount = height;
+        alongDir = RIGHT;
+        acrossDir = BOTTOM;
+    }
+    else {
+        rowLength = height;
+        rowCount = width;
+        alongDir = BOTTOM;
+        acrossDir = RIGHT;
+    }
+}
+
+/**
+ * @brief 枚举行状态并建立逐格转移的索引。
+ * 正向前缀树逐层在序列末尾追加与最后一格兼容的模块，反向前缀树逐层在序列开头插入，两棵树的最后一层
+ * 都是全部行状态。替换了前 k 格的中间状态由 (正向深度 k 的节点, 反向深度 rowLength - k 的节点) 编号，
+ * 每一层的中间状态数量都不能超过 maxStates。
+ */
+bool WFCStripSampler::build() {
+    if (built) return true;
+    if (buildFailed) return false;
+    if (rowLength <= 0 || moduleCount == 0) {
+        std::cout << "Strip sampler: empty grid or ruleset." << std::endl;
+        buildFailed = true;
+        return false;
+    }
+
+    // 1. 逐层展开两棵前缀树，同一深度的节点连续存放，子节点按父节点的顺序排列
+    int backDir = alongDir == RIGHT ? LEFT : TOP;
+    std::vector<int> forwardParents(1, -1);
+    forwardModules.assign(1, -1);
+    forwardLevels.assign(1, 0);
+    reverseModules.assign(1, -1);
+    reverseParents.assign(1, -1);
+    reverseLevels.assign(1, 0);
+    auto expand = [&](std::vector<int>& modules, std::vector<int>& parents, std::vector<int>& levels, int dir) {
+        int levelBegin = levels.back();
+        int levelEnd = static_cast<int>(modules.size());
+        levels.push_back(levelEnd);
+        for (int n = levelBegin; n < levelEnd; ++n) {
+            auto addChild = [&](int m) {
+                modules.push_back(m);
+                parents.push_back(n);
+            };
+            if (modules[n] < 0) for (int m = 0; m < moduleCount; ++m) addChild(m);
+            else ruleset->forEachCompatible(modules[n], dir, addChild);
+        }
+    };
+    for (int depth = 0; depth < rowLength; ++depth) {
+        expand(forwardModules, forwardParents, forwardLevels, alongDir);
+        expand(reverseModules, reverseParents, reverseLevels, backDir);
+        if (static_cast<int>(forwardModules.size()) - forwardLevels.back() > maxStates) {
+            std::cout << "Strip sampler: more than " << maxStates << " row states (row length " << rowLength << ")." << std::endl;
+            buildFailed = true;
+            return false;
+        }
+    }
+    forwardLevels.push_back(static_cast<int>(forwardModules.size()));
+    reverseLevels.push_back(static_cast<int>(reverseModules.size()));
+
+    // 删除无法延伸到整行的前缀，它们对应的中间状态总权重恒为 0；子节点仍按父节点的顺序连续存放
+    auto prune = [&](std::vector<int>& modules, std::vector<int>& parents, std::vector<int>& levels) {
+        int nodeCount = static_cast<int>(modules.size());
+        std::vector<int> remap(nodeCount, 0);
+        for (int n = levels[rowLength]; n < nodeCount; ++n) remap[n] = 1;
+        for (int n = nodeCount - 1; n > 0; --n) {
+            if (remap[n]) remap[parents[n]] = 1;
+        }
+        int kept = 0, depth = 0;
+        for (int n = 0; n < nodeCount; ++n) {
+            while (depth <= rowLength && levels[depth] == n) levels[depth++] = kept;
+            if (!remap[n]) {
+                remap[n] = -1;
+                continue;
+            }
+            remap[n] = kept;
+            modules[kept] = modules[n];
+            parents[kept] = n == 0 ? -1 : remap[parents[n]];
+            kept++;
+        }
+        levels[rowLength + 1] = kept;
+        modules.resize(kept);
+        parents.resize(kept);
+    };
+    prune(forwardModules, forwardParents, forwardLevels);
+    prune(reverseModules, reverseParents, reverseLevels);
+    if (forwardModules.size() <= 1) {
+        std::cout << "Strip sampler: no valid row of length " << rowLength << "." << std::endl;
+        buildFailed = true;
+        noValidRow = true;
+        return false;
+    }
+
+    // 由父节点求出正向前缀树的子节点范围：节点 n 的第一个子节点下标 = 1 + 排在 n 之前的节点的子节点总数
+    forwardChildStarts.assign(forwardModules.size() + 1, 0);
+    for (size_t n = 1; n < forwardModules.size(); ++n) forwardChildStarts[forwardParents[n] + 1]++;
+    forwardChildStarts[0] = 1;
+    for (size_t n = 1; n < forwardChildStarts.size(); ++n) forwardChildStarts[n] += forwardChildStarts[n - 1];
+
+    for (int k = 0; k <= rowLength; ++k) {
+        if (static_cast<double>(levelSize(forwardLevels, k)) * levelSize(reverseLevels, rowLength - k) > maxStates) {
+            std::cout << "Strip sampler: more than " << maxStates << " intermediate states at cell " << k << "." << std::endl;
+            buildFailed = true;
+            return false;
+        }
+    }
+
+    // 2. 由正向叶子回溯父节点得到每个行状态的模块序列、权重和计数倍数
+    int leafBegin = forwardLevels[rowLength];
+    stateCount = levelSize(forwardLevels, rowLength);
+    rowModules.assign(static_cast<size_t>(stateCount) * rowLength, -1);
+    stateWeights.assign(stateCount, 1.0);
+    stateMultiplicity.assign(stateCount, 1.0);
+    for (int s = 0; s < stateCount; ++s) {
+        int node = leafBegin + s;
+        for (int i = rowLength - 1; i >= 0; --i, node = forwardParents[node]) {
+            int m = forwardModules[node];
+            rowModules[static_cast<size_t>(s) * rowLength + i] = m;
+            stateWeights[s] *= ruleset->getWeight(m);
+            if (ruleset->isCompressed()) stateMultiplicity[s] *= static_cast<double>(ruleset->getClassMembers(m).size());
+        }
+    }
+
+    // 3. 反向叶子按模块序列在正向前缀树中查找，建立两种编号的对应关系
+    reverseOfState.assign(stateCount, -1);
+    for (int leaf = reverseLevels[rowLength]; leaf < reverseLevels[rowLength + 1]; ++leaf) {
+        int node = 0;
+        for (int r = leaf; r != 0; r = reverseParents[r]) {
+            int child = forwardChildStarts[node];
+            while (forwardModules[child] != reverseModules[r]) ++child;
+            node = child;
+        }
+        reverseOfState[node - leafBegin] = leaf - reverseLevels[rowLength];
+    }
+
+    acrossRows.assign(static_cast<size_t>(moduleCount) * wordsPerDomain, 0);
+    for (int m = 0; m < moduleCount; ++m) {
+        ruleset->orCompatibility(m, acrossDir, &acrossRows[static_cast<size_t>(m) * wordsPerDomain]);
+    }
+    layers.assign(static_cast<size_t>(rowLength) + 1, std::vector<double>());
+    for (int k = 0; k <= rowLength; ++k) {
+        layers[k].resize(static_cast<size_t>(levelSize(forwardLevels, k)) * levelSize(reverseLevels, rowLength - k));
+    }
+    columns.assign(rowLength, std::vector<double>());
+    for (int k = 0; k < rowLength; ++k) columns[k].resize(levelSize(forwardLevels, k));
+    blockRows = std::max(1, static_cast<int>(std::ceil(std::sqrt(static_cast<double>(rowCount)))));
+    built = true;
+    return true;
+}
+
+/**
+ * @brief 由下一行的权重计算所有中间状态的总权重。
+ * layers[rowLength] 就是下一行的权重；layers[k][a, b] 表示新行前 k 格为 a、旧行后 rowLength - k 格为 b 时，
+ * 新行剩余各格的所有合法填法的权重之和：第 k 格枚举 a 的子节点 c，要求与 b 的第一格兼容，
+ * 再累加 layers[k + 1][c, b 去掉第一格]。layers[0] 即为旧行每个状态的转移总权重（按反向叶子编号）。
+ * @param next 下一行的权重（按行状态编号）。
+ */
+void WFCStripSampler::transfer(const double* next) {
+    std::copy(next, next + stateCount, layers[rowLength].begin());
+    for (int k = rowLength - 1; k >= 0; --k) {
+        int suffixDepth = rowLength - k;
+        int suffixBegin = reverseLevels[suffixDepth];
+        int suffixCount = levelSize(reverseLevels, suffixDepth);
+        int shorterBegin = reverseLevels[suffixDepth - 1];
+        int shorterCount = levelSize(reverseLevels, suffixDepth - 1);
+        int childLevel = forwardLevels[k + 1];
+        const std::vector<double>& deeper = layers[k + 1];
+        std::vector<double>& out = layers[k];
+        for (int a = forwardLevels[k]; a < forwardLevels[k + 1]; ++a) {
+            double* row = &out[static_cast<size_t>(a - forwardLevels[k]) * suffixCount];
+            for (int b = 0; b < suffixCount; ++b) {
+                int suffix = suffixBegin + b;
+                const uint64_t* allowed = &acrossRows[static_cast<size_t>(reverseModules[suffix]) * wordsPerDomain];
+                int shorter = reverseParents[suffix] - shorterBegin;
+                double sum = 0.0;
+                for (int c = forwardChildStarts[a]; c < forwardChildStarts[a + 1]; ++c) {
+                    int m = forwardModules[c];
+                    if (allowed[m / 64] & (uint64_t(1) << (m % 64))) {
+                        sum += deeper[static_cast<size_t>(c - childLevel) * shorterCount + shorter];
+                    }
+                }
+                row[b] = sum;
+            }
+        }
+    }
+}
+
+/**
+ * @brief 由下一行的后向权重计算本行：out[s] = weights[s] * (s 的所有后继的后向权重之和)。
+ * @param next 下一行的后向权重；为空时表示本行是最后一行。
+ * @param weights 每个状态自身的权重（或计数倍数）。
+ * @param out [out] 本行的后向权重。
+ * @param normalize 是否把最大值缩放为 1；长条中权重的乘积会溢出，而缩放不改变同一行内的比例，不影响采样。
+ */
+void WFCStripSampler::backwardStep(const double* next, const std::vector<double>& weights, double* out, bool normalize) {
+    if (next) transfer(next);
+    double maxValue = 0.0;
+    for (int s = 0; s < stateCount; ++s) {
+        out[s] = next ? weights[s] * layers[0][reverseOfState[s]] : weights[s];
+        maxValue = std::max(maxValue, out[s]);
+    }
+    if (normalize && maxValue > 0.0) {
+        for (int s = 0; s < stateCount; ++s) out[s] /= maxValue;
+    }
+}
+
+/**
+ * @brief 重新计算第 block 块内各行的后向权重。
+ * 块内最后一行由下一块的检查点（或最后一行的初始值）推出，结果写入 blockBetas。
+ */
+void WFCStripSampler::computeBlock(int block) {
+    int first = block * blockRows;
+    int last = std::min(first + blockRows, rowCount) - 1;
+    for (int row = last; row >= first; --row) {
+        double* out = &blockBetas[static_cast<size_t>(row - first) * stateCount];
+        const double* next = nullptr;
+        if (row == last && row + 1 < rowCount) next = &checkpoints[static_cast<size_t>(block + 1) * stateCount];
+        else if (row < last) next = out + stateCount;
+        backwardStep(next, stateWeights, out, true);
+    }
+}
+
+/**
+ * @brief 在 state 的后继中逐格抽取下一行。
+ * 旧行已经确定，只需要 layers 中后缀等于旧行后缀的那一列：columns[k][a] 为新行前 k 格为 a 时，
+ * 剩余各格与旧行逐格兼容的所有填法的后向权重之和，沿正向前缀树自底向上求出。
+ * 第 k 格在 a 的子节点中按 columns[k + 1] 抽取，因此整行的概率正比于下一行的后向权重。
+ * @param state 旧行的状态。
+ * @param betas 下一行的后向权重。
+ * @return 下一行的状态，没有后继时返回 -1。
+ */
+int WFCStripSampler::drawNextState(int state, const double* betas) {
+    const int* previous = &rowModules[static_cast<size_t>(state) * rowLength];
+    for (int k = rowLength - 1; k >= 0; --k) {
+        const uint64_t* allowed = &acrossRows[static_cast<size_t>(previous[k]) * wordsPerDomain];
+        const double* deeper = k + 1 == rowLength ? betas : columns[k + 1].data();
+        int childLevel = forwardLevels[k + 1];
+        for (int a = forwardLevels[k]; a < forwardLevels[k + 1]; ++a) {
+            double sum = 0.0;
+            for (int c = forwardChildStarts[a]; c < forwardChildStarts[a + 1]; ++c) {
+                int m = forwardModules[c];
+                if (allowed[m / 64] & (uint64_t(1) << (m % 64))) sum += deeper[c - childLevel];
+            }
+            columns[k][a - forwardLevels[k]] = sum;
+        }
+    }
+
+    int a = 0;
+    for (int k = 0; k < rowLength; ++k) {
+        const uint64_t* allowed = &acrossRows[static_cast<size_t>(previous[k]) * wordsPerDomain];
+        const double* deeper = k + 1 == rowLength ? betas : columns[k + 1].data();
+        candidates.clear();
+        double total = 0.0;
+        for (int c = forwardChildStarts[a]; c < forwardChildStarts[a + 1]; ++c) {
+            int m = forwardModules[c];
+            if (!(allowed[m / 64] & (uint64_t(1) << (m % 64)))) continue;
+            double weight = deeper[c - forwardLevels[k + 1]];
+            if (weight <= 0.0) continue;
+            candidates.push_back({ c, weight });
+            total += weight;
+        }
+        if (candidates.empty()) return -1;
+        double r = std::uniform_real_distribution<double>(0.0, total)(rng);
+        a = candidates.back().first;
+        for (const auto& candidate : candidates) {
+            r -= candidate.second;
+            if (r < 0.0) {
+                a = candidate.first;
+                break;
+            }
+        }
+    }
+    return a - forwardLevels[rowLength];
+}
+
+/**
+ * @brief 按模块权重的乘积精确采样一张地图。
+ * 后向动态规划先从最后一行推到第一行，只保存每 blockRows 行一个检查点；前向采样进入新的块时，
+ * 从下一块的检查点重新推出本块各行的后向权重。第一行按后向权重抽取，之后每行在上一行的后继中逐格抽取，
+ * 每行的开销是两次后向递推加一次沿前缀树的抽取。
+ */
+bool WFCStripSampler::sample(unsigned int seed, std::vector<int>& result, bool expandClasses) {
+    if (!build()) return false;
+    rng.seed(seed);
+
+    // 1. 后向动态规划，保存每块第一行的后向权重
+    int blockCount = (rowCount + blockRows - 1) / blockRows;
+    checkpoints.assign(static_cast<size_t>(blockCount) * stateCount, 0.0);
+    blockBetas.assign(static_cast<size_t>(blockRows) * stateCount, 0.0);
+    std::vector<double> current(stateCount), next(stateCount);
+    for (int row = rowCount - 1; row >= 0; --row) {
+        backwardStep(row + 1 < rowCount ? next.data() : nullptr, stateWeights, current.data(), true);
+        if (row % blockRows == 0) {
+            std::copy(current.begin(), current.end(), checkpoints.begin() + static_cast<size_t>(row / blockRows) * stateCount);
+        }
+        std::swap(current, next);
+    }
+
+    // 2. 逐块前向采样
+    result.assign(static_cast<size_t>(width) * height, -1);
+    int state = -1;
+    for (int block = 0; block < blockCount; ++block) {
+        computeBlock(block);
+        int first = block * blockRows;
+        int last = std::min(first + blockRows, rowCount) - 1;
+        for (int row = first; row <= last; ++row) {
+            const double* betas = &blockBetas[static_cast<size_t>(row - first) * stateCount];
+            if (row == 0) {
+                double total = 0.0;
+                for (int s = 0; s < stateCount; ++s) total += betas[s];
+                double r = total > 0.0 ? std::uniform_real_distribution<double>(0.0, total)(rng) : 0.0;
+                for (int s = 0; s < stateCount && total > 0.0; ++s) {
+                    if (betas[s] <= 0.0) continue;
+                    state = s;
+                    r -= betas[s];
+                    if (r < 0.0) break;
+                }
+            }
+            else {
+                state = drawNextState(state, betas);
+            }
+            if (state < 0) {
+                std::cout << "Strip sampler: no valid " << width << "x" << height << " map for this ruleset." << std::endl;
+                result.clear();
+                return false;
+            }
+            const int* modules = &rowModules[static_cast<size_t>(state) * rowLength];
+            for (int i = 0; i < rowLength; ++i) {
+                result[cellOf(row, i)] = expandClasses ? expandModule(modules[i]) : modules[i];
+            }
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief 统计合法地图的总数。
+ * 与采样相同的后向递推，但以计数倍数代替权重，并且不做缩放，第一行各状态之和即为总数。
+ * 没有任何合法行时总数就是 0，这是有效的结果，只有状态数超出上限才返回 false。
+ */
+bool WFCStripSampler::countTilings(double& count) {
+    count = 0.0;
+    if (!build()) return noValidRow;
+    std::vector<double> current(stateCount), next(stateCount);
+    for (int row = rowCount - 1; row >= 0; --row) {
+        backwardStep(row + 1 < rowCount ? next.data() : nullptr, stateMultiplicity, current.data(), false);
+        std::swap(current, next);
+    }
+    for (int s = 0; s < stateCount; ++s) count += next[s];
+    return true;
+}
+
+/**
+ * @brief 把压缩规则集的等价类按成员权重展开为原始模块。
+ * 等价类的权重是成员权重之和，先按类权重采样再按成员权重展开，等价于直接按原始模块的权重采样。
+ */
+int WFCStripSampler::expandModule(int module) {
+    if (!ruleset->isCompressed()) {
+        return module;
+    }
+    const Ruleset& original = *ruleset->getParent();
+    const std::vector<int>& members = ruleset->getClassMembers(module);
+    double r = std::uniform_real_distribution<double>(0.0, ruleset->getWeight(module))(rng);
+    for (int member : members) {
+        r -= original.getWeight(member);
+        if (r < 0.0) return member;
+    }
+    return members.back();
+}
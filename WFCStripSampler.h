@@ -0,0 +1,107 @@
+#pragma once
+
+#include <vector>
+#include <memory>
+#include <random>
+#include <cstdint>
+#include "Ruleset.h"
+#include "BitUtils.h"
+
+/**
+ * @class WFCStripSampler
+ * @brief 窄长条地图的转移矩阵精确采样器。
+ * 沿较短的边把网格切成若干行（宽度不大于高度时为水平行，否则为竖直列），行内相容的模块序列即为行状态，
+ * 相邻两行逐格相容时可以转移。采样时从最后一行向前做动态规划，得到每个行状态"之后所有行"的总权重，
+ * 再从第一行开始逐行按权重抽取，结果严格服从按 Module::weight 乘积加权的全部合法地图的分布，
+ * 不需要回溯，每行的耗时固定。
+ * 转移矩阵不显式存储：一行的转移拆成逐格替换的 rowLength 步，中间状态是"新行的前缀 + 旧行的后缀"，
+ * 前缀和后缀分别由正向、反向两棵前缀树编号，因此每行的开销与行状态数乘以每格的兼容模块数成正比，
+ * 而不是行状态数的平方。动态规划只保存每 sqrt(行数) 行一个检查点，长条的内存随行数的平方根增长。
+ * 行状态数量随行宽指数增长，只适合 8 到 12 格宽的走廊类地图；超出上限时 build() 返回 false。
+ * 不支持全局数量上限。
+ */
+class WFCStripSampler {
+public:
+    /**
+     * @brief WFCStripSampler 构造函数。
+     * @param width 网格宽度。
+     * @param height 网格高度。
+     * @param ruleset 共享的只读规则集（可以是压缩规则集）。
+     * @param maxStates 行状态以及每一步中间状态的数量上限。
+     */
+    WFCStripSampler(int width, int height, std::shared_ptr<const Ruleset> ruleset, int maxStates = 1 << 18);
+
+    /**
+     * @brief 枚举行状态并建立逐格转移的索引。sample() 和 countTilings() 会在需要时自动调用。
+     * @return 状态数量超过上限时返回 false。
+     */
+    bool build();
+
+    /**
+     * @brief 按模块权重的乘积精确采样一张地图。
+     * @param seed 随机种子。
+     * @param result [out] 按 y * width + x 排列的模块索引。
+     * @param expandClasses 压缩规则集时是否按成员权重展开为原始模块索引；为 false 时保留等价类索引，
+     *                      由调用者自行展开（例如需要遵守单个成员的全局上限时）。
+     * @return 转移矩阵无法建立或规则集在该尺寸下无解时返回 false。
+     */
+    bool sample(unsigned int seed, std::vector<int>& result, bool expandClasses = true);
+
+    /**
+     * @brief 统计合法地图的总数（压缩规则集按原始模块计数）。
+     * @param count [out] 合法地图数量；超过 2^53 时为近似值，没有合法行时为 0。
+     * @return 状态数量超过上限、转移矩阵无法建立时返回 false。
+     */
+    bool countTilings(double& count);
+
+    int getRowLength() const { return rowLength; }
+    int getRowCount() const { return rowCount; }
+    int getRowStateCount() const { return stateCount; }
+    bool hasNoValidRow() const { return noValidRow; }
+
+private:
+    int width, height;                                  // 网格尺寸
+    int rowLength;                                      // 每行的单元格数（较短的边）
+    int rowCount;                                       // 行数（较长的边）
+    int alongDir, acrossDir;                            // 行内相邻方向、相邻两行之间的方向
+    int moduleCount;                                    // 规则集字母表大小
+    int wordsPerDomain;                                 // 每个兼容掩码的 64 位字数
+    std::shared_ptr<const Ruleset> ruleset;             // 共享的只读规则集
+    int maxStates;                                      // 状态数量上限
+    bool built = false;                                 // 是否已建立
+    bool buildFailed = false;                           // 上一次建立是否失败
+    bool noValidRow = false;                            // 失败原因是否为不存在合法的行（此时合法地图数为 0）
+
+    // 正向前缀树：深度 k 的节点是行首 k 格的相容序列，同一深度的节点连续存放
+    std::vector<int> forwardModules;                    // [节点]：该节点（序列最后一格）的模块，根节点为 -1
+    std::vector<int> forwardChildStarts;                // [节点]：子节点为 [forwardChildStarts[n], forwardChildStarts[n + 1])
+    std::vector<int> forwardLevels;                     // [深度]：该深度第一个节点的下标，最后一项为节点总数
+    // 反向前缀树：深度 j 的节点是行尾 j 格的相容序列，父节点为去掉第一格后的序列
+    std::vector<int> reverseModules;                    // [节点]：序列第一格的模块，根节点为 -1
+    std::vector<int> reverseParents;                    // [节点]：父节点
+    std::vector<int> reverseLevels;                     // [深度]：该深度第一个节点的下标，最后一项为节点总数
+    std::vector<uint64_t> acrossRows;                   // [模块 * wordsPerDomain]：acrossDir 方向的兼容掩码
+
+    int stateCount = 0;                                 // 行状态数量（正向前缀树的叶子）
+    std::vector<int> reverseOfState;                    // [状态]：同一序列在反向前缀树中的叶子
+    std::vector<int> rowModules;                        // [状态 * rowLength + i]：行状态中第 i 格的模块
+    std::vector<double> stateWeights;                   // [状态]：行内模块权重之积
+    std::vector<double> stateMultiplicity;              // [状态]：行内等价类成员数之积（计数用）
+    std::vector<std::vector<double>> layers;            // [k][前缀 * 后缀数 + 后缀]：替换了前 k 格的中间状态的总权重
+
+    // 采样时的动态规划缓冲区
+    std::vector<double> checkpoints;                    // [检查点 * stateCount + 状态]：每 blockRows 行保存一次的后向权重
+    std::vector<double> blockBetas;                     // [块内行 * stateCount + 状态]：当前块重新计算出的后向权重
+    std::vector<std::vector<double>> columns;           // [k][前缀]：逐格抽取时，与旧行后缀兼容的剩余填法的总权重
+    std::vector<std::pair<int, double>> candidates;     // 逐格抽取时的候选模块与权重
+    int blockRows = 0;                                  // 检查点间隔
+    std::mt19937 rng;                                   // 采样用的随机数生成器
+
+    int cellOf(int row, int i) const { return alongDir == RIGHT ? row * width + i : i * width + row; } // 行坐标转单元格索引
+    int levelSize(const std::vector<int>& levels, int depth) const { return levels[depth + 1] - levels[depth]; } // 某深度的节点数
+    void transfer(const double* next);                  // 由下一行的权重计算所有中间状态的总权重
+    void backwardStep(const double* next, const std::vector<double>& weights, double* out, bool normalize); // 由下一行的后向权重计算本行
+    void computeBlock(int block);                       // 重新计算一个块内各行的后向权重
+    int drawNextState(int state, const double* betas);  // 在 state 的后继中逐格抽取下一行
+    int expandModule(int module);                       // 把压缩规则集的等价类展开为原始模块
+};
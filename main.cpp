@@ -12,6 +12,8 @@
 // 包含项目自定义的头文件
 #include "DataManager.h"    // 负责加载和保存项目数据
 #include "WFCGenerator.h"   // WFC 算法核心生成器
+#include "WFCGeneratorPool.h" // 复用生成器实例的对象池
+#include "WFCDiagnostics.h"  // 生成失败时诊断规则集
 #include "TileMap.h"        // 用于在 SFML 中渲染瓦片地图
 
 /**
@@ -19,35 +21,36 @@
  * @param dataManager 数据管理器，提供生成所需的配置
  * @param tileMap 瓦片地图对象，用于加载和显示生成的地图
  * @param status 用于反馈生成状态的字符串引用
+ * @param stats 用于保存求解统计信息
+ * @param generatorPool 生成器池，连续生成同样尺寸的地图时复用生成器
  */
-void generateAndUpdateMap(DataManager& dataManager, TileMap& tileMap, std::string& status, std::map<std::string, int>& counts)
+void generateAndUpdateMap(DataManager& dataManager, TileMap& tileMap, std::string& status, std::map<std::string, int>& counts, WFCStats& stats, WFCGeneratorPool& generatorPool)
 {
     // 更新状态信息，通知用户正在生成
     status = "生成中... (Generating...)";
     std::cout << "Generating new map..." << std::endl;
 
-    // 1. 创建 WFC 生成器实例，传入网格尺寸和模块定义
-    WFCGenerator generator(dataManager.gridWidth, dataManager.gridHeight, dataManager.modules);
+    // 1. 从生成器池中取出与当前规则集和网格尺寸匹配的生成器（没有则新建），并用随机种子重置
+    auto generator = generatorPool.acquire(dataManager.ruleset, dataManager.gridWidth, dataManager.gridHeight, dataManager.seed);
 
-    // 2. 设置随机种子
-    generator.setSeed(dataManager.seed);
-
-    // 3. 设置全局模块数量限制
+    // 2. 设置全局模块数量限制
     for (const auto& limit_pair : dataManager.globalLimits) {
-        generator.setGlobalModuleLimit(limit_pair.first, limit_pair.second);
+        generator->setGlobalModuleLimit(limit_pair.first, limit_pair.second);
     }
 
-    // 4. 运行 WFC 生成算法
-    if (generator.generate()) {
+    // 3. 运行 WFC 生成算法
+    bool success = generator->generate();
+    stats = generator->getStats(); // 成功与否都保存求解统计
+    if (success) {
         // 如果生成成功
         status = "生成成功！ (Success!)";
         std::cout << "Generation successful!" << std::endl;
-        counts = generator.getGlobalModuleCounts(); // 保存计数值
+        counts = generator->getGlobalModuleCounts(); // 保存计数值
         // 使用生成的网格数据加载并更新 TileMap
         tileMap.load(
             dataManager.tilesetPath, // 瓦片集的路径
             sf::Vector2u(dataManager.tileSize, dataManager.tileSize), // 单个瓦片的尺寸
-            generator.getGrid() // 生成的网格数据
+            generator->getGrid() // 生成的网格数据
         );
     }
     else {
@@ -55,6 +58,17 @@ void generateAndUpdateMap(DataManager& dataManager, TileMap& tileMap, std::strin
         counts.clear(); // 生成失败则清空
         status = "生成失败！ (Failed!)";
         std::cout << "Generation failed." << std::endl;
+
+        // 在小探测网格上诊断失败原因：最小冲突集输出到控制台，结论显示在状态栏
+        WFCDiagnostics diagnostics(dataManager.ruleset);
+        for (const auto& limit_pair : dataManager.globalLimits) {
+            diagnostics.setGlobalModuleLimit(limit_pair.first, limit_pair.second);
+        }
+        DiagnosticReport report = diagnostics.diagnose(dataManager.gridWidth, dataManager.gridHeight);
+        for (const std::string& line : report.lines) {
+            std::cout << line << std::endl;
+        }
+        status += " " + report.summary;
     }
 }
 
@@ -96,6 +110,10 @@ int main()
     sf::Clock deltaClock; // 用于计算 ImGui 更新所需的时间差
     std::string statusMessage = "准备就绪 (Ready)"; // 用于在 UI 中显示状态信息
     std::map<std::string, int> lastGeneratedCounts; //存储上一次成功生成的模块数量
+    WFCStats lastStats; // 存储上一次生成的求解统计
+    WFCGeneratorPool generatorPool; // 生成器池，重复点击生成时复用生成器
+    const Ruleset* pooledRuleset = nullptr; // 池中生成器对应的规则集和尺寸
+    int pooledWidth = 0, pooledHeight = 0;
 
     // 主循环，只要窗口打开就一直运行
     while (window.isOpen())
@@ -191,8 +209,15 @@ int main()
         // -- 主操作按钮 --
         if (ImGui::Button("生成新地图 (Generate New Map)", ImVec2(160, 0)))
         {
+            // 尺寸或规则集改变后旧规格的生成器不会再被取用，释放它们占用的内存池
+            if (dataManager.ruleset.get() != pooledRuleset || dataManager.gridWidth != pooledWidth || dataManager.gridHeight != pooledHeight) {
+                generatorPool.clear();
+                pooledRuleset = dataManager.ruleset.get();
+                pooledWidth = dataManager.gridWidth;
+                pooledHeight = dataManager.gridHeight;
+            }
             // 点击按钮时，调用地图生成函数
-            generateAndUpdateMap(dataManager, tileMap, statusMessage, lastGeneratedCounts);
+            generateAndUpdateMap(dataManager, tileMap, statusMessage, lastGeneratedCounts, lastStats, generatorPool);
         }
 
         ImGui::SameLine(); //同一行
@@ -269,6 +294,19 @@ int main()
                     ImGui::EndTable();
                 }
             }
+
+            // 求解统计
+            ImGui::Text("耗时 (Time): %.2f ms", lastStats.elapsedMs);
+            ImGui::Text("支持缓存 (Support cache): %lld 命中 / %lld 未命中 (%.1f%%)%s",
+                lastStats.supportCacheHits, lastStats.supportCacheMisses, lastStats.supportCacheHitRate() * 100.0,
+                lastStats.supportCacheBypassed ? " [已绕过 bypassed]" : "");
+            ImGui::Text("回溯 (Backtracks): %lld", lastStats.backtracks);
+            ImGui::Text("冲突学习 (Nogoods): %lld 冲突 / %d 学到 / %lld 剪枝 / %d 重启",
+                lastStats.conflicts, lastStats.learnedNogoods, lastStats.nogoodPrunes, lastStats.restarts);
+            ImGui::Text("前瞻 (Lookahead): %lld 试探 / %lld 移除", lastStats.lookaheadProbes, lastStats.lookaheadPrunes);
+            ImGui::Text("批量坍缩 (Batches): %lld 批 / %lld 单元格 / %lld 回滚",
+                lastStats.batches, lastStats.batchedCells, lastStats.batchRollbacks);
+            ImGui::Text("可达掩码 (Reachability): %lld 移除", lastStats.reachabilityPrunes);
         }
 
         // -- 状态显示 --